@@ -1,5 +1,58 @@
 #include "lib.h"
 
+#define CANHCB_NODE_NUM			16		/* one DST bit per address */
+
+/* Counters of one source */
+typedef struct canhcb_peer
+{
+	UINT32 recv;            /* from the address, the rest as well */
+	UINT32 missing;
+	UINT32 duplicate;
+	UINT32 reorder;
+	UINT32 corrupt;
+}CANHCB_PEER_S;
+
+/* Counters of the send task, published by it */
+typedef struct canhcb_tx
+{
+	UINT64 send_pkts;
+	UINT32 tickSkipped;     /* timer ticks no packet was sent for */
+	UINT32 catchUp;         /* packets sent for an earlier tick */
+	UINT32 sendFail;
+	UINT32 sendRate;        /* packets a second, in 1/1000 */
+	UINT32 sent[CANHCB_NODE_NUM];   /* to the address */
+}CANHCB_TX_S;
+
+/*
+ * Counters published to canhcb_show(). tx is the last snapshot of the send
+ * task, copied in by the polling task.
+ */
+typedef struct canhcb_stats
+{
+	UINT32 len_crc_error;
+	UINT32 bit_error;
+	UINT32 timing_error;
+	UINT32 arbitration_error;
+	UINT32 coding_error;
+	UINT64 recv_pkts;
+	UINT64 missing;         /* sequence numbers never received */
+	UINT32 duplicate;       /* sequence numbers received twice */
+	UINT32 reorder;         /* received after a later one */
+	UINT32 corrupt;         /* delivered with a bad cksum or length */
+	CANHCB_TX_S tx;
+	CANHCB_PEER_S peer[CANHCB_NODE_NUM];
+}CANHCB_STATS_S;
+
+/*
+ * Latency from the sender stamp. The time bases of two boards are not
+ * synchronized, so packets of other boards are measured over the least
+ * delay seen from that board.
+ */
+typedef struct canhcb_lat
+{
+	LAT_HIST hist[CANHCB_NODE_NUM];
+}CANHCB_LAT_S;
+
 typedef struct canhcb_status
 {
 	int canhcbFd;
@@ -8,15 +61,21 @@ typedef struct canhcb_status
 	CANHCB_PKT_S RECV_PKT;
 	BOOL INITED;
 	SEM_ID muxSem;
-	UINT32 len_crc_error;
-	UINT32 bit_error;
-	UINT32 timing_error;
-	UINT32 arbitration_error;
-	UINT32 coding_error;
-	UINT64 send_pkts;
-	UINT64 recv_pkts;
-	QJOB job;
-	UINT32 in_process;
+	SEM_ID sendSem;
+	volatile UINT32 ticks;  /* counted by the timer ISR */
+	CANHCB_STATS_S stats;
+	CANHCB_TX_S tx;
+	SEQ_WIN rxSeq[CANHCB_NODE_NUM];
+	UINT32 txSeq[CANHCB_NODE_NUM];
+	INT64 minDelay[CANHCB_NODE_NUM];
+	BOOL delaySeen[CANHCB_NODE_NUM];
+	INT32 credit[CANHCB_NODE_NUM];      /* weighted schedule */
+	UINT32 next;                        /* round robin schedule */
+	CANHCB_LAT_S lat;
+	STAT_SNAP * pSnap;
+	STAT_SNAP * pTxSnap;
+	STAT_SNAP * pLatSnap;
+	RAND_STATE rand;
 }CANHCB_STATUS_S;
 
 static CANHCB_STATUS_S * pStatus = NULL;
@@ -26,8 +85,41 @@ static CANHCB_STATUS_S * pStatus = NULL;
 #define CANHCB_BW_LIMIT			500000	/* 0.5Mbps */
 #define CANHCB_TIMER_FREQ		(CANHCB_BW_LIMIT / 8 / CANHCB_PKT_LEN)
 
+/*
+ * Packet layout, cksum of the rest, the sequence number of the destination
+ * and the send time base, both LSB first
+ */
+#define CANHCB_PKT_SEQ			4
+#define CANHCB_PKT_STAMP		8
+#define CANHCB_PKT_DATA			16
+
+#define CANHCB_BURST			8		/* packets sent on one wakeup */
+#define CANHCB_RATE_PERIOD		10		/* seconds sendRate is measured over */
+
+#define CANHCB_SEND_TASK_PRIORITY		20
 #define CANHCB_POLLING_TASK_PRIORITY	40
 
+/* Destination schedules */
+enum
+{
+	CANHCB_SCHED_RR,            /* every destination in turn */
+	CANHCB_SCHED_WEIGHTED       /* in proportion to the weights */
+};
+
+/*
+ * Shell variables
+ *
+ * canhcbBurst : packets sent at most when the sender wakes up late, the
+ *               ticks missed are caught up to this, 1 skips them all
+ * canhcbSched : 0 sends to every destination in turn, 1 in proportion to
+ *               the weights given to canhcb_dst_add()
+ */
+UINT32 canhcbBurst = CANHCB_BURST;
+UINT32 canhcbSched = CANHCB_SCHED_RR;
+
+/* Weight of every destination, none set sends to ourselves */
+static UINT32 canhcbWeight[CANHCB_NODE_NUM];
+
 static void canhcb_stat_update(void)
 {
 	INT32 regVal;
@@ -40,24 +132,99 @@ static void canhcb_stat_update(void)
 	if (regVal != 0)
 	{
 		if (regVal & SAC_CANHCB_STATUS_BIT_ERR)
-			pStatus->bit_error++;
+			pStatus->stats.bit_error++;
 		if (regVal & SAC_CANHCB_STATUS_TIMING_ERR)
-			pStatus->timing_error++;
+			pStatus->stats.timing_error++;
 		if (regVal & SAC_CANHCB_STATUS_ARBITRATION_FAIL)
-			pStatus->arbitration_error++;
+			pStatus->stats.arbitration_error++;
 		if (regVal & SAC_CANHCB_STATUS_CODE_ERR)
-			pStatus->coding_error++;
+			pStatus->stats.coding_error++;
 		if (regVal & SAC_CANHCB_STATUS_LEN_CRC_ERR)
-			pStatus->len_crc_error++;
+			pStatus->stats.len_crc_error++;
 	}
 }
 
 static CANHCB_PKT_S * canhcb_hook(UINT32 src)
 {
-	pStatus->recv_pkts++;
 	return &pStatus->RECV_PKT;
 }
 
+/* Account a received sequence number of src */
+static void canhcb_seq_check(UINT32 src, UINT32 seq)
+{
+	CANHCB_PEER_S * pPeer = &pStatus->stats.peer[src];
+	UINT32 gap;
+
+	switch (seq_win_check(&pStatus->rxSeq[src], seq, &gap))
+	{
+	case SEQ_NEW:
+		pStatus->stats.missing += gap;
+		pPeer->missing += gap;
+		break;
+	case SEQ_DUP:
+		pStatus->stats.duplicate++;
+		pPeer->duplicate++;
+		break;
+	default:
+		/* Filled a gap counted missing */
+		pStatus->stats.reorder++;
+		pPeer->reorder++;
+		if (pPeer->missing)
+		{
+			pStatus->stats.missing--;
+			pPeer->missing--;
+		}
+		break;
+	}
+}
+
+/* Latency of a packet of src sent at stamp */
+static void canhcb_lat_record(UINT32 src, UINT64 stamp)
+{
+	INT64 delay = timebase_get() - stamp;
+
+	if (src != addr_get())
+	{
+		if (!pStatus->delaySeen[src] || (delay < pStatus->minDelay[src]))
+		{
+			pStatus->minDelay[src] = delay;
+			pStatus->delaySeen[src] = TRUE;
+		}
+		delay -= pStatus->minDelay[src];
+	}
+
+	if (delay >= 0)
+		lat_hist_add(&pStatus->lat.hist[src], delay);
+}
+
+/* Verify a received packet, the driver fills it after canhcb_hook() */
+static void canhcb_pkt_check(const CANHCB_PKT_S * pPkt)
+{
+	const UINT8 * buf = pPkt->pkt_buf;
+	UINT32 src = pPkt->SRC % CANHCB_NODE_NUM;
+	UINT64 stamp = 0;
+	UINT32 seq;
+	int i;
+
+	pStatus->stats.recv_pkts++;
+	pStatus->stats.peer[src].recv++;
+
+	if ((pPkt->DLC != CANHCB_PKT_LEN) || cksum_buf_verify((char *)buf, pPkt->DLC))
+	{
+		pStatus->stats.corrupt++;
+		pStatus->stats.peer[src].corrupt++;
+		return;
+	}
+
+	seq = buf[CANHCB_PKT_SEQ] | (buf[CANHCB_PKT_SEQ + 1] << 8) |
+			(buf[CANHCB_PKT_SEQ + 2] << 16) | ((UINT32)buf[CANHCB_PKT_SEQ + 3] << 24);
+	for (i = 7; i >= 0; i--)
+		stamp = (stamp << 8) | buf[CANHCB_PKT_STAMP + i];
+
+	canhcb_seq_check(src, seq);
+	canhcb_lat_record(src, stamp);
+}
+
 static CANHCB_PKT_S * canhcb_hook_null(UINT32 src)
 {
 	return NULL;
@@ -78,11 +245,265 @@ static int polling_task(void)
 		do
 		{
 			ret = CANHCBPktPoll(pStatus->canhcbFd);
+			if (ret == 0)
+				canhcb_pkt_check(&pStatus->RECV_PKT);
 		}while(ret != -EAGAIN);
 		
 		/* Update status */
 		canhcb_stat_update();
+
+		/* Publish counters for canhcb_show() */
+		if (stat_snap_due(pStatus->pSnap))
+		{
+			stat_snap_read(pStatus->pTxSnap, &pStatus->stats.tx);
+			stat_snap_publish(pStatus->pSnap, &pStatus->stats);
+			stat_snap_publish(pStatus->pLatSnap, &pStatus->lat);
+		}
+	}
+}
+
+static void canhcb_stats_print(REPORT * pRep, const CANHCB_STATS_S * pStats, const CANHCB_LAT_S * pLat)
+{
+	const CANHCB_PEER_S * pPeer;
+	char name[8];
+	int i;
+
+	/* construct information content */
+	report_printf(pRep, "\n"
+			"*********** HCB ***********\n"
+			"LEN CRC Error          : %u\n"
+			"Bit Error              : %u\n"
+			"Timing Error           : %u\n"
+			"Arbitration Error      : %u\n"
+			"4B5B Coding Error      : %u\n"
+			"Total Send Pkts        : %llu\n"
+			"Total Recv Pkts        : %llu\n"
+			"Total Missing Pkts     : %llu\n"
+			"Duplicate Pkts         : %u\n"
+			"Reordered Pkts         : %u\n"
+			"Corrupted Pkts         : %u\n"
+			"Send Rate              : %u.%03u/s of %u/s\n"
+			"Skipped Ticks          : %u\n"
+			"Catch-up Pkts          : %u\n"
+			"Send Fail              : %u\n",
+			pStats->len_crc_error,
+			pStats->bit_error,
+			pStats->timing_error,
+			pStats->arbitration_error,
+			pStats->coding_error,
+			pStats->tx.send_pkts,
+			pStats->recv_pkts,
+			pStats->missing,
+			pStats->duplicate,
+			pStats->reorder,
+			pStats->corrupt,
+			pStats->tx.sendRate / 1000, pStats->tx.sendRate % 1000, CANHCB_TIMER_FREQ,
+			pStats->tx.tickSkipped,
+			pStats->tx.catchUp,
+			pStats->tx.sendFail
+	);
+
+	/* All pairs of this board, a row for every address sent to or heard */
+	report_printf(pRep, "\n%8s\t%10s%10s%10s%10s%10s%10s\n", "NODE",
+			"SENT", "RECV", "MISSING", "DUP", "REORDER", "CORRUPT");
+	for (i = 0; i < CANHCB_NODE_NUM; i++)
+	{
+		pPeer = &pStats->peer[i];
+		if (pStats->tx.sent[i] || pPeer->recv)
+			report_printf(pRep, "%8d\t%10u%10u%10u%10u%10u%10u\n", i,
+					pStats->tx.sent[i], pPeer->recv, pPeer->missing,
+					pPeer->duplicate, pPeer->reorder, pPeer->corrupt);
+	}
+
+	if (pLat == NULL)
+		return;
+	report_printf(pRep, "\n%8s\t%10s%12s%12s%12s%12s%12s\n", "LAT(us)",
+			"COUNT", "MIN", "P50", "P99", "P99.9", "MAX");
+	for (i = 0; i < CANHCB_NODE_NUM; i++)
+	{
+		if (pLat->hist[i].count == 0)
+			continue;
+		snprintf(name, sizeof(name), "%d", i);
+		lat_hist_print(pRep, name, &pLat->hist[i]);
+		report_printf(pRep, "\n");
+	}
+}
+
+/* statlog keeps the counters only */
+static void canhcb_stats_format(REPORT * pRep, const void * p)
+{
+	canhcb_stats_print(pRep, p, NULL);
+}
+
+/* 64 bit counters written by a board of the other byte order */
+static void canhcb_stats_swap(void * p)
+{
+	CANHCB_STATS_S * pStats = p;
+
+	statlog_swap64(&pStats->tx.send_pkts, 1);
+	statlog_swap64(&pStats->recv_pkts, 1);
+	statlog_swap64(&pStats->missing, 1);
+}
+
+const STATLOG_CODEC canhcbStatlog =
+{
+	STATLOG_ID_HCB, sizeof(CANHCB_STATS_S), canhcb_stats_format, canhcb_stats_swap
+};
+
+/* Next destination of the schedule, ourselves when none is set */
+static UINT32 canhcb_dst_next(void)
+{
+	UINT32 i, dst, total = 0, best = CANHCB_NODE_NUM;
+
+	if (canhcbSched == CANHCB_SCHED_WEIGHTED)
+	{
+		/* Smooth weighted round robin, spreads the heavy ones out */
+		for (i = 0; i < CANHCB_NODE_NUM; i++)
+		{
+			if (canhcbWeight[i] == 0)
+				continue;
+			total += canhcbWeight[i];
+			pStatus->credit[i] += canhcbWeight[i];
+			if ((best == CANHCB_NODE_NUM) || (pStatus->credit[i] > pStatus->credit[best]))
+				best = i;
+		}
+		if (best != CANHCB_NODE_NUM)
+		{
+			pStatus->credit[best] -= total;
+			return best;
+		}
+	}
+	else
+	{
+		for (i = 0; i < CANHCB_NODE_NUM; i++)
+		{
+			dst = (pStatus->next + i) % CANHCB_NODE_NUM;
+			if (canhcbWeight[dst])
+			{
+				pStatus->next = dst + 1;
+				return dst;
+			}
+		}
+	}
+
+	return addr_get();
+}
+
+/*
+ * Add addr to the destinations with weight, 0 removes it. Could be called
+ * from shell at any time, no destination sends to ourselves only.
+ */
+int canhcb_dst_add(UINT32 addr, UINT32 weight)
+{
+	if (addr >= CANHCB_NODE_NUM)
+		return -EINVAL;
+
+	canhcbWeight[addr] = weight;
+	if (pStatus)
+		pStatus->credit[addr] = 0;
+	return 0;
+}
+
+void canhcb_dst_clear(void)
+{
+	memset(canhcbWeight, 0, sizeof(canhcbWeight));
+}
+
+/* Send one sequence numbered packet to the next destination */
+static INT32 canhcb_pkt_send(void)
+{
+	UINT8 * buf = pStatus->SEND_PKT.pkt_buf;
+	UINT32 dst = canhcb_dst_next();
+	UINT32 seq = pStatus->txSeq[dst];
+	UINT64 stamp;
+	UINT32 crc;
+	INT32 ret;
+	int i;
+	
+	/* Randomize the packet data, the sequence number is under the cksum */
+	rand_range_r(buf + CANHCB_PKT_DATA, CANHCB_PKT_LEN - CANHCB_PKT_DATA, &pStatus->rand);
+	buf[CANHCB_PKT_SEQ] = seq & 0xFF;
+	buf[CANHCB_PKT_SEQ + 1] = (seq >> 8) & 0xFF;
+	buf[CANHCB_PKT_SEQ + 2] = (seq >> 16) & 0xFF;
+	buf[CANHCB_PKT_SEQ + 3] = (seq >> 24) & 0xFF;
+	stamp = timebase_get();
+	for (i = 0; i < 8; i++)
+		buf[CANHCB_PKT_STAMP + i] = (stamp >> (8 * i)) & 0xFF;
+	crc = cksum_calc(0, (char *)buf + 4, CANHCB_PKT_LEN - 4);
+	memcpy(buf, &crc, sizeof(crc));
+	
+	pStatus->SEND_PKT.DLC = CANHCB_PKT_LEN;
+	pStatus->SEND_PKT.DST = 0x0001 << dst;
+	ret = CANHCBPktSend(pStatus->canhcbFd, &pStatus->SEND_PKT);
+	if (ret == 0)
+	{
+		/* Do statics recording, a packet not sent keeps its number */
+		pStatus->tx.send_pkts++;
+		pStatus->tx.sent[dst]++;
+		pStatus->txSeq[dst]++;
 	}
+	else
+		pStatus->tx.sendFail++;
+
+	return ret;
+}
+
+/*
+ * One packet for every timer tick. Ticks missed while the task was held
+ * off are caught up to canhcbBurst packets and counted skipped beyond.
+ */
+static int send_task(void)
+{
+	UINT64 rateStart, now, freq = timebase_freq();
+	UINT64 rateSent = 0;
+	UINT32 done, owed, burst, n;
+
+	done = pStatus->ticks;
+	rateStart = timebase_get();
+
+	FOREVER
+	{
+		assert(semTake(pStatus->sendSem, WAIT_FOREVER) == OK);
+
+		owed = pStatus->ticks - done;
+		done += owed;
+		burst = canhcbBurst ? canhcbBurst : 1;
+		if (owed > burst)
+		{
+			pStatus->tx.tickSkipped += owed - burst;
+			owed = burst;
+		}
+
+		for (n = 0; n < owed; n++)
+		{
+			if (canhcb_pkt_send())
+				break;
+		}
+		if (n > 1)
+			pStatus->tx.catchUp += n - 1;
+
+		/* Trigger packet polling task */
+		if (n)
+			assert(semGive(pStatus->muxSem) == OK);
+
+		now = timebase_get();
+		if (now - rateStart >= freq * CANHCB_RATE_PERIOD)
+		{
+			pStatus->tx.sendRate = (pStatus->tx.send_pkts - rateSent) * 1000 * freq /
+					(now - rateStart);
+			rateSent = pStatus->tx.send_pkts;
+			rateStart = now;
+		}
+
+		/* Publish on every wakeup, the copy is small */
+		stat_snap_publish(pStatus->pTxSnap, &pStatus->tx);
+	}
+}
+
+static void canhcb_tick(INT32 arg)
+{
+	pStatus->ticks++;
+	semGive(pStatus->sendSem);
 }
 
 static void canhcb_init(void)
@@ -115,10 +536,27 @@ static void canhcb_init(void)
 	
 	pStatus->RECV_PKT.pkt_buf = malloc(CANHCB_BUF_LEN);
 	assert(pStatus->RECV_PKT.pkt_buf != NULL);
+
+	/* Initialize random stream */
+	rand_state_init(&pStatus->rand, RAND_STREAM_HCB);
+
+	/* Initialize statistics snapshot */
+	pStatus->pSnap = stat_snap_create(sizeof(pStatus->stats), STAT_SNAP_PERIOD);
+	assert(pStatus->pSnap);
+	stat_snap_publish(pStatus->pSnap, &pStatus->stats);
+	statlog_register(STATLOG_ID_HCB, pStatus->pSnap);
+	pStatus->pTxSnap = stat_snap_create(sizeof(pStatus->tx), STAT_SNAP_PERIOD);
+	assert(pStatus->pTxSnap);
+	stat_snap_publish(pStatus->pTxSnap, &pStatus->tx);
+	pStatus->pLatSnap = stat_snap_create(sizeof(pStatus->lat), STAT_SNAP_PERIOD);
+	assert(pStatus->pLatSnap);
+	stat_snap_publish(pStatus->pLatSnap, &pStatus->lat);
 	
 	/* Initialize semaphore */
 	pStatus->muxSem = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
 	assert(pStatus->muxSem != NULL);
+	pStatus->sendSem = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
+	assert(pStatus->sendSem != NULL);
 	
 	/* Register the NULL Hook */
 	assert(CANHCBHookRegister(pStatus->canhcbFd, canhcb_hook_null) == 0);
@@ -132,44 +570,9 @@ static void canhcb_init(void)
 	/* All done */
 	pStatus->INITED = TRUE;
 	
-	/* Start polling task */
+	/* Start polling and sending task */
 	taskSpawn("tCANHCBPoll", CANHCB_POLLING_TASK_PRIORITY, 0, 0x40000, polling_task, 0,0,0,0,0,0,0,0,0,0);
-}
-
-static void canhcb_send_task(void * arg)
-{
-	INT32 ret;
-	
-	/* Randomize the packet data */
-	rand_range(pStatus->SEND_PKT.pkt_buf, CANHCB_PKT_LEN);
-	
-	/* Send one packet to ourselves */
-	pStatus->SEND_PKT.DLC = CANHCB_PKT_LEN;
-	pStatus->SEND_PKT.DST = 0x0001 << addr_get();
-	ret = CANHCBPktSend(pStatus->canhcbFd, &pStatus->SEND_PKT);
-	if (ret == 0)
-	{
-		/* Do statics recording */
-		pStatus->send_pkts++;
-		
-		/* Trigger packet polling task
-		 *
-		 * Due to the packet loop back time, there is always one packet missing. 
-		 */
-		assert(semGive(pStatus->muxSem) == OK);
-	}
-	pStatus->in_process = 0;
-}
-
-static void canhcb_send(INT32 len)
-{
-	if (pStatus->in_process == 0)
-	{
-		pStatus->in_process = 1;
-		pStatus->job.func = canhcb_send_task;
-		QJOB_SET_PRI(&pStatus->job, 20);
-		queue_add(&pStatus->job);
-	}
+	taskSpawn("tCANHCBSend", CANHCB_SEND_TASK_PRIORITY, 0, 0x4000, send_task, 0,0,0,0,0,0,0,0,0,0);
 }
 
 static void canhcb_start(void)
@@ -184,56 +587,24 @@ static void canhcb_start(void)
          * pkts one second. */
         assert(TimerDisable(pStatus->timerFd) == 0);
         assert(TimerFreqSet(pStatus->timerFd, CANHCB_TIMER_FREQ) == 0);
-        assert(TimerISRSet(pStatus->timerFd, canhcb_send, 0) == 0);
+        assert(TimerISRSet(pStatus->timerFd, canhcb_tick, 0) == 0);
         assert(TimerEnable(pStatus->timerFd) == 0);
 	}
 }
 
-static void canhcb_sender_suspend(void)
+static void canhcb_show(REPORT * pRep)
 {
-	/* check if HCB inited */
-	assert(pStatus->INITED);
-	
-	/* Make sure all packets sent is received */
-	assert(TimerDisable(pStatus->timerFd) == 0);
-	taskDelay(1);
-	assert(semGive(pStatus->muxSem) == OK);
-}
+	CANHCB_STATS_S stats;
+	CANHCB_LAT_S * pLat;
 
-static void canhcb_sender_resume(void)
-{
-	/* Re-enable timer */
-	assert(TimerEnable(pStatus->timerFd) == 0);
-}
+	if (!pStatus || stat_snap_read(pStatus->pSnap, &stats))
+		return;
 
-static void canhcb_show(char * buf)
-{
-    if (!pStatus)
-        return;
-	canhcb_sender_suspend();
-	
-	/* construct information content */
-	sprintf(buf, "\n"
-			"*********** HCB ***********\n"
-			"LEN CRC Error          : %u\n"
-			"Bit Error              : %u\n"
-			"Timing Error           : %u\n"
-			"Arbitration Error      : %u\n"
-			"4B5B Coding Error      : %u\n"
-			"Total Send Pkts        : %llu\n"
-			"Total Recv Pkts        : %llu\n"
-			"Total Missing Pkts     : %llu\n",
-			pStatus->len_crc_error,
-			pStatus->bit_error,
-			pStatus->timing_error,
-			pStatus->arbitration_error,
-			pStatus->coding_error,
-			pStatus->send_pkts,
-			pStatus->recv_pkts,
-			pStatus->send_pkts - pStatus->recv_pkts
-	);
-	
-	canhcb_sender_resume();
+	pLat = malloc(sizeof(*pLat));
+	assert(pLat);
+	canhcb_stats_print(pRep, &stats,
+			stat_snap_read(pStatus->pLatSnap, pLat) == 0 ? pLat : NULL);
+	free(pLat);
 }
 
 MODULE_REGISTER(canhcb);
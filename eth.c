@@ -5,70 +5,145 @@
 #define ETH_BUFFER_LEN	1600
 
 #define ETH_BW_LIMIT	10000000    /* BW limited to 10Mbps */
+#define ETH_RATE_MAX	100000000	/* a port sends 100Mbps at most */
 #define ETH_PKT_LEN		1500		/* Packet Length */
-#define ETH_TIMER_FREQ	(ETH_BW_LIMIT / 8 / ETH_PKT_LEN * 2)
+#define ETH_WIRE_EXTRA	24			/* preamble, FCS and gap on the wire */
+#define ETH_TIMER_FREQ	2000		/* pacing and receive ticks */
+#define ETH_BURST		1			/* packets a port sends back to back */
+#define ETH_POOL_SIZE	16			/* prebuilt payloads of every port */
+#define ETH_RATE_PERIOD	1			/* seconds the rates are measured over */
+
+#define ETH_RECV_TASK_PRIORITY	50
+#define ETH_SEND_TASK_PRIORITY	55
+
+/*
+ * Packet layout after the MAC header, the sequence number of the port
+ * LSB first, then the payload. The last 4 bytes are the Fletcher cksum
+ * of everything before, so a packet is verified on its own.
+ */
+#define ETH_PKT_SEQ		14
+#define ETH_PKT_DATA	18
+#define ETH_PKT_CKSUM	(ETH_PKT_LEN - 4)
+
+
+/* Counters of one port sender, published by it */
+typedef struct eth_tx
+{
+	UINT32 	pktSent;				/* Ethernet packet sent */
+	UINT32 	pktSendFail;			/* Ethernet packet send fail */
+	UINT64  txBytes;
+}ETH_TX_S;
+
+/*
+ * Counters published to eth_show(). tx are the last snapshots of the
+ * senders, copied in by the receive task.
+ */
+typedef struct eth_stats
+{
+	ETH_TX_S tx[ETH_DEV_COUNT];
+	UINT32 	pktRecv[ETH_DEV_COUNT];	/* Ethernet packet received */
+	UINT32  pktRecvFail[ETH_DEV_COUNT]; /* Ethernet packet recv fail */
+	UINT32  missing[ETH_DEV_COUNT];	/* sequence numbers never received */
+	UINT32  duplicate[ETH_DEV_COUNT];
+	UINT32  reorder[ETH_DEV_COUNT];	/* received after a later one */
+	UINT32  present;				/* Bit i set if eth(i+1) exists */
+	UINT64  rxBytes[ETH_DEV_COUNT];
+	UINT32  txBps[ETH_DEV_COUNT];	/* over the last ETH_RATE_PERIOD */
+	UINT32  txPps[ETH_DEV_COUNT];
+	UINT32  rxBps[ETH_DEV_COUNT];
+	UINT32  rxPps[ETH_DEV_COUNT];
+	UINT32  rate[ETH_DEV_COUNT];	/* bps asked, wire overhead included */
+}ETH_STATS_S;
+
+/* Token bucket of one port, in bits */
+typedef struct eth_pacer
+{
+	UINT64  tokens;
+	UINT64  last;					/* time base of the last refill */
+}ETH_PACER_S;
 
 typedef struct eth_status
 {
 	BOOL 	ethInited;
 	INT32 	hdr[ETH_DEV_COUNT];		/* Ethernet device handler */
-	UINT8 * pkt; 	                /* Ethernet packet buffer */
+	UINT8 * pool[ETH_DEV_COUNT];	/* ETH_POOL_SIZE packets of every port */
+	UINT32  poolIdx[ETH_DEV_COUNT];
 	SEM_ID  rxSem;
-	UINT32 	pktCksum[ETH_DEV_COUNT];/* Ethernet packet cksum */
-	UINT32 	pktSent[ETH_DEV_COUNT]; /* Ethernet packet sent */
-	UINT32 	pktRecv[ETH_DEV_COUNT];	/* Ethernet packet received */
-	UINT32 	pktSendFail[ETH_DEV_COUNT]; /* Ethernet packet send fail */
-	UINT32  pktRecvFail[ETH_DEV_COUNT]; /* Ethernet packet recv fail */
+	SEM_ID  txSem[ETH_DEV_COUNT];
+	ETH_PACER_S pacer[ETH_DEV_COUNT];
+	UINT32 	txSeq[ETH_DEV_COUNT];	/* next sequence number to send */
+	SEQ_WIN rxSeq[ETH_DEV_COUNT];
+	ETH_STATS_S stats;				/* Live counters */
+	STAT_SNAP * pSnap;				/* Counters snapshot */
+	ETH_TX_S tx[ETH_DEV_COUNT];		/* Live counters of the senders */
+	STAT_SNAP * pTxSnap[ETH_DEV_COUNT];
 	INT32 	timerFd;				/* Timer Handler */
+	RAND_STATE rand;				/* Payload random stream */
 }ETH_STATUS_S;
 
 static ETH_STATUS_S * pStatus = NULL;
 
+/* bps and packets back to back of every port, set by eth_rate_set() */
+static UINT32 ethRate[ETH_DEV_COUNT] = { ETH_BW_LIMIT, ETH_BW_LIMIT, ETH_BW_LIMIT, ETH_BW_LIMIT };
+static UINT32 ethBurst[ETH_DEV_COUNT] = { ETH_BURST, ETH_BURST, ETH_BURST, ETH_BURST };
+
+/* Account a verified packet of port idx */
+static void eth_seq_check(UINT32 idx, const UINT8 * pBuf)
+{
+	UINT32 seq, gap;
+
+	seq = pBuf[ETH_PKT_SEQ] | (pBuf[ETH_PKT_SEQ + 1] << 8) |
+			(pBuf[ETH_PKT_SEQ + 2] << 16) | ((UINT32)pBuf[ETH_PKT_SEQ + 3] << 24);
+
+	switch (seq_win_check(&pStatus->rxSeq[idx], seq, &gap))
+	{
+	case SEQ_NEW:
+		pStatus->stats.missing[idx] += gap;
+		break;
+	case SEQ_DUP:
+		pStatus->stats.duplicate[idx]++;
+		break;
+	default:
+		pStatus->stats.reorder[idx]++;
+		if (pStatus->stats.missing[idx])
+			pStatus->stats.missing[idx]--;
+		break;
+	}
+}
+
 static BOOL eth_counting_hook(void * pDev, UINT8 *pBuf, UINT32 bufLen)
 {
 	ETHERNET_DEV_S * p = pDev;
-	UINT32 cksum, idx;
+	UINT32 cksum, inside, idx;
 
 	/* Hook for eth1 - eth4 */
 	if ((strlen(p->name) == 4) &&
 			(strncmp(p->name, ETH_DEV_PREFIX, strlen(ETH_DEV_PREFIX)) == 0))
 	{
 	    idx = p->name[strlen(ETH_DEV_PREFIX)] - '1';
-	    calc_fletcher32(pBuf, bufLen, &cksum);
-#if 0
-	    switch(idx)
+	    if (bufLen != ETH_PKT_LEN)
 	    {
-	    /*
-	     * eth1 <-> eth2
-	     * eth3 <-> eth4
-	     */
-	    case 0:
-	    case 2:
-	        if (cksum == pStatus->pktCksum[idx + 1])
-	            pStatus->pktRecv[idx] ++;
-	        break;
-	    case 1:
-	    case 3:
-	        if (cksum == pStatus->pktCksum[idx - 1])
-	            pStatus->pktRecv[idx] ++;
-	        break;
+	        pStatus->stats.pktRecvFail[idx] ++;
+	        return TRUE;
+	    }
+	    calc_fletcher32(pBuf, ETH_PKT_CKSUM, &cksum);
+	    memcpy(&inside, pBuf + ETH_PKT_CKSUM, sizeof(inside));
+	    if (cksum == inside)
+	    {
+	        pStatus->stats.pktRecv[idx] ++;
+	        pStatus->stats.rxBytes[idx] += bufLen;
+	        eth_seq_check(idx, pBuf);
 	    }
-#endif
-	    if (cksum == pStatus->pktCksum[idx])
-	        pStatus->pktRecv[idx] ++;
 	    else
-	        pStatus->pktRecvFail[idx] ++;
+	        pStatus->stats.pktRecvFail[idx] ++;
 	}
     return TRUE;
 }
 
-static int eth_send_random(INT32 hdr, UINT8 * pkt, UINT32 pkt_len, UINT32 * cksum)
+/* Build a packet with random payload, eth_pkt_send() numbers it */
+static void eth_pkt_build(INT32 hdr, UINT8 * pkt, UINT32 pkt_len)
 {
-    int i;
-
-    assert (pStatus);
-    assert (pStatus->ethInited);
-    assert (pkt_len > 14);
+    assert (pkt_len > ETH_PKT_DATA + 4);
 
     /* broadcast */
     memset(pkt, 0xFF, 6);
@@ -78,49 +153,225 @@ static int eth_send_random(INT32 hdr, UINT8 * pkt, UINT32 pkt_len, UINT32 * cksu
     pkt[12] = 0x08;
     pkt[13] = 0x00;
     /* fillup random stuff */
-    for (i = 14; i < pkt_len; i++)
-        pkt[i] = rand();
+    rand_range_r(pkt + ETH_PKT_DATA, pkt_len - 4 - ETH_PKT_DATA, &pStatus->rand);
+}
 
-    calc_fletcher32(pkt, pkt_len, cksum);
+/* Number the next pool packet of port i, close it with the cksum and send */
+static int eth_pkt_send(int i, UINT32 pkt_len)
+{
+    UINT8 * pkt = pStatus->pool[i] + ETH_BUFFER_LEN * pStatus->poolIdx[i];
+    UINT32 seq = pStatus->txSeq[i];
+    UINT32 cksum;
+    int ret;
+
+    pkt[ETH_PKT_SEQ] = seq & 0xFF;
+    pkt[ETH_PKT_SEQ + 1] = (seq >> 8) & 0xFF;
+    pkt[ETH_PKT_SEQ + 2] = (seq >> 16) & 0xFF;
+    pkt[ETH_PKT_SEQ + 3] = (seq >> 24) & 0xFF;
+
+    /* cksum of all the rest closes the packet */
+    calc_fletcher32(pkt, pkt_len - 4, &cksum);
+    memcpy(pkt + pkt_len - 4, &cksum, sizeof(cksum));
+
+    ret = EthernetSendPkt(pStatus->hdr[i], pkt, pkt_len);
+    if (ret == 0)
+    {
+        pStatus->txSeq[i]++;
+        pStatus->poolIdx[i] = (pStatus->poolIdx[i] + 1) % ETH_POOL_SIZE;
+    }
+    return ret;
+}
+
+/*
+ * Refill the bucket of a port for the time passed. It holds the burst and
+ * two ticks of tokens on top, so a late tick loses nothing and the rate is
+ * reached whatever the burst.
+ */
+static UINT64 eth_pacer_refill(ETH_PACER_S * pPacer, UINT32 rate, UINT32 burst, UINT64 cost)
+{
+    UINT64 now = timebase_get();
+    UINT64 depth;
+
+    pPacer->tokens += (now - pPacer->last) * rate / timebase_freq();
+    pPacer->last = now;
 
-    return EthernetSendPkt(hdr, pkt, pkt_len);
+    depth = burst * cost + (UINT64)rate * 2 / ETH_TIMER_FREQ;
+    if (pPacer->tokens > depth)
+        pPacer->tokens = depth;
+
+    return pPacer->tokens;
 }
 
+/* Sender of one port, paced by its token bucket */
+static int eth_send_task(int i)
+{
+    ETH_PACER_S * pPacer = &pStatus->pacer[i];
+    ETH_TX_S * pTx = &pStatus->tx[i];
+    UINT64 cost = (ETH_PKT_LEN + ETH_WIRE_EXTRA) * 8;
+
+    pPacer->last = timebase_get();
+
+    FOREVER
+    {
+        semTake(pStatus->txSem[i], WAIT_FOREVER);
+
+        eth_pacer_refill(pPacer, ethRate[i], ethBurst[i], cost);
+        while (pPacer->tokens >= cost)
+        {
+            if (eth_pkt_send(i, ETH_PKT_LEN))
+            {
+                /* Full, try again on the next tick */
+                pTx->pktSendFail++;
+                break;
+            }
+            pPacer->tokens -= cost;
+            pTx->pktSent++;
+            pTx->txBytes += ETH_PKT_LEN;
+        }
+
+        /* Publish on every wakeup, the copy is small */
+        stat_snap_publish(pStatus->pTxSnap[i], pTx);
+    }
+
+    return 0;
+}
+
+/* Rates of every port and direction since the last call */
+static void eth_rate_measure(UINT64 elapsed, ETH_STATS_S * pLast)
+{
+    ETH_STATS_S * pStats = &pStatus->stats;
+    UINT64 freq = timebase_freq();
+    int i;
+
+    for (i = 0; i < ETH_DEV_COUNT; i++)
+    {
+        pStats->txBps[i] = (pStats->tx[i].txBytes - pLast->tx[i].txBytes) * 8 * freq / elapsed;
+        pStats->rxBps[i] = (pStats->rxBytes[i] - pLast->rxBytes[i]) * 8 * freq / elapsed;
+        pStats->txPps[i] = (UINT64)(pStats->tx[i].pktSent - pLast->tx[i].pktSent) * freq / elapsed;
+        pStats->rxPps[i] = (UINT64)(pStats->pktRecv[i] - pLast->pktRecv[i]) * freq / elapsed;
+        pStats->rate[i] = ethRate[i];
+    }
+    *pLast = *pStats;
+}
+
+/* Receive all the ports on every tick */
 static int eth_task_entry(void)
 {
-    uint32_t cnt = 0;
+    ETH_STATS_S last = pStatus->stats;
+    UINT64 now, start = timebase_get();
+
     FOREVER
     {
         int i;
 
         semTake(pStatus->rxSem, WAIT_FOREVER);
-        cnt ++;
         for (i = 0; i < ETH_DEV_COUNT; i++)
         {
             uint32_t pktLimit = 32;
             if (pStatus->hdr[i] < 0)
                 continue;
             EthernetRecvPoll(pStatus->hdr[i], &pktLimit);
-            if (cnt >= 2)
-            {
-                if (eth_send_random(pStatus->hdr[i], pStatus->pkt, ETH_PKT_LEN, &pStatus->pktCksum[i]))
-                    pStatus->pktSendFail[i]++;
-                else
-                    pStatus->pktSent[i]++;
-            }
+            /* Sender counters, never written here */
+            stat_snap_read(pStatus->pTxSnap[i], &pStatus->stats.tx[i]);
         }
 
-        if (cnt >= 2)
-            cnt = 0;
+        now = timebase_get();
+        if (now - start >= (UINT64)timebase_freq() * ETH_RATE_PERIOD)
+        {
+            eth_rate_measure(now - start, &last);
+            start = now;
+        }
+
+        /* Publish counters for eth_show() */
+        stat_snap_update(pStatus->pSnap, &pStatus->stats);
     }
 
     return 0;
 }
 
-static void eth_start(void)
+/* Pace all the ports and the receive task */
+static void eth_tick(_Vx_usr_arg_t arg)
 {
+    int i;
+
+    semGive(pStatus->rxSem);
+    for (i = 0; i < ETH_DEV_COUNT; i++)
+    {
+        if (pStatus->txSem[i])
+            semGive(pStatus->txSem[i]);
+    }
+}
+
+/*
+ * Set port (1 - 4, 0 for all) to send mbps on the wire with bursts of
+ * burst packets back to back, 0 mbps stops it. Could be called from shell
+ * at any time.
+ */
+int eth_rate_set(UINT32 port, UINT32 mbps, UINT32 burst)
+{
+    int i;
+
+    if ((port > ETH_DEV_COUNT) || ((UINT64)mbps * 1000000 > ETH_RATE_MAX))
+        return -EINVAL;
+
+    for (i = 0; i < ETH_DEV_COUNT; i++)
+    {
+        if (port && (port != i + 1))
+            continue;
+        ethRate[i] = mbps * 1000000;
+        ethBurst[i] = burst ? burst : 1;
+    }
+    return 0;
+}
+
+static void eth_stats_format(REPORT * pRep, const void * p)
+{
+	const ETH_STATS_S * pStats = p;
 	int i;
 
+	report_printf(pRep, "\n*********** ETH ***********\n");
+	for (i = 0; i < ETH_DEV_COUNT; i++)
+	{
+	    if (pStats->present & (1 << i))
+            report_printf(pRep,
+                    "eth%d : Send %u Recv %u Send Fail %u Recv Fail %u Missing %u Dup %u Reorder %u\n",
+                    i + 1, pStats->tx[i].pktSent, pStats->pktRecv[i],
+                    pStats->tx[i].pktSendFail, pStats->pktRecvFail[i],
+                    pStats->missing[i], pStats->duplicate[i], pStats->reorder[i]);
+	}
+
+	report_printf(pRep, "\n%8s\t%10s%12s%10s%12s%10s\n", "RATE", "ASKED(M)",
+	        "TX(Mbps)", "TX(pps)", "RX(Mbps)", "RX(pps)");
+	for (i = 0; i < ETH_DEV_COUNT; i++)
+	{
+	    if (pStats->present & (1 << i))
+	        report_printf(pRep, "%7s%d\t%10u%8u.%03u%10u%8u.%03u%10u\n", "eth", i + 1,
+	                pStats->rate[i] / 1000000,
+	                pStats->txBps[i] / 1000000, pStats->txBps[i] / 1000 % 1000, pStats->txPps[i],
+	                pStats->rxBps[i] / 1000000, pStats->rxBps[i] / 1000 % 1000, pStats->rxPps[i]);
+	}
+}
+
+/* 64 bit counters written by a board of the other byte order */
+static void eth_stats_swap(void * p)
+{
+	ETH_STATS_S * pStats = p;
+	int i;
+
+	for (i = 0; i < ETH_DEV_COUNT; i++)
+		statlog_swap64(&pStats->tx[i].txBytes, 1);
+	statlog_swap64(pStats->rxBytes, ETH_DEV_COUNT);
+}
+
+const STATLOG_CODEC ethStatlog =
+{
+	STATLOG_ID_ETH, sizeof(ETH_STATS_S), eth_stats_format, eth_stats_swap
+};
+
+static void eth_start(void)
+{
+	int i, j;
+
 	if (pStatus && pStatus->ethInited)
 		return;
 
@@ -136,6 +387,8 @@ static void eth_start(void)
 
 	pStatus->ethInited = FALSE;
 
+	rand_state_init(&pStatus->rand, RAND_STREAM_ETH);
+
 	for (i = 0; i < ETH_DEV_COUNT; i++)
 	{
 		/* Get eth device name */
@@ -147,14 +400,22 @@ static void eth_start(void)
 		if (pStatus->hdr[i] < 0)
 			continue;
 
-		/* Initialize packet buffer */
-		pStatus->pkt = malloc(ETH_BUFFER_LEN);
-		assert(pStatus->pkt != NULL);
+		/* Prebuilt packets, only numbered and cksummed when sent */
+		pStatus->pool[i] = malloc(ETH_BUFFER_LEN * ETH_POOL_SIZE);
+		assert(pStatus->pool[i] != NULL);
+		for (j = 0; j < ETH_POOL_SIZE; j++)
+			eth_pkt_build(pStatus->hdr[i], pStatus->pool[i] + ETH_BUFFER_LEN * j, ETH_PKT_LEN);
+
+		/* Initialize pacer */
+		pStatus->txSem[i] = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+		assert(pStatus->txSem[i]);
 
 		/* Initialize packet counter */
-		pStatus->pktSent[i] = 0;
-		pStatus->pktRecv[i] = 0;
-		pStatus->pktSendFail[i] = 0;
+		pStatus->stats.pktRecv[i] = 0;
+		pStatus->stats.present |= 1 << i;
+		pStatus->pTxSnap[i] = stat_snap_create(sizeof(pStatus->tx[i]), STAT_SNAP_PERIOD);
+		assert(pStatus->pTxSnap[i]);
+		stat_snap_publish(pStatus->pTxSnap[i], &pStatus->tx[i]);
 
 		/* Drop all current packets */
 		assert(EthernetPktDrop(pStatus->hdr[i], 512) >= 0);
@@ -165,51 +426,44 @@ static void eth_start(void)
 		assert(EthernetHookEnable(pStatus->hdr[i]) == 0);
 	}
 
-    taskSpawn("tEthLoopback", 50, VX_FP_TASK, 0x4000, eth_task_entry,
-            1,2,3,4,5,6,7,8,9,10);
-
-	pStatus->timerFd = timer_set(ETH_TIMER_FREQ, pStatus->rxSem);
-	assert(pStatus->timerFd >= 0);
+	pStatus->pSnap = stat_snap_create(sizeof(pStatus->stats), STAT_SNAP_PERIOD);
+	assert(pStatus->pSnap);
+	stat_snap_publish(pStatus->pSnap, &pStatus->stats);
+	statlog_register(STATLOG_ID_ETH, pStatus->pSnap);
 
-	pStatus->ethInited = TRUE;
-}
+    taskSpawn("tEthLoopback", ETH_RECV_TASK_PRIORITY, VX_FP_TASK, 0x4000, eth_task_entry,
+            1,2,3,4,5,6,7,8,9,10);
+	for (i = 0; i < ETH_DEV_COUNT; i++)
+	{
+		char taskName[12];
 
-static void eth_sender_suspend(void)
-{
-	/* check if inited */
-	assert(pStatus->ethInited);
+		if (pStatus->hdr[i] < 0)
+			continue;
+		sprintf(taskName, "tEthSend%d", i + 1);
+		taskSpawn(taskName, ETH_SEND_TASK_PRIORITY, VX_FP_TASK, 0x4000, eth_send_task,
+				i,0,0,0,0,0,0,0,0,0);
+	}
 
-	/* Make sure all packets sent is received */
+	pStatus->timerFd = timer_get();
+	assert(pStatus->timerFd >= 0);
 	assert(TimerDisable(pStatus->timerFd) == 0);
-	taskDelay(1);
-}
-
-static void eth_sender_resume(void)
-{
-	/* Re-enable timer */
+	assert(TimerFreqSet(pStatus->timerFd, ETH_TIMER_FREQ) == 0);
+	assert(TimerISRSet(pStatus->timerFd, eth_tick, 0) == 0);
 	assert(TimerEnable(pStatus->timerFd) == 0);
+
+	pStatus->ethInited = TRUE;
 }
 
-static void eth_show(char * buf)
+static void eth_show(REPORT * pRep)
 {
-	int i;
+	ETH_STATS_S stats;
 
-	if (pStatus->ethInited)
+	if (pStatus && pStatus->ethInited)
 	{
-		eth_sender_suspend();
-
-		sprintf(buf, "\n*********** ETH ***********\n");
-		for (i = 0; i < ETH_DEV_COUNT; i++)
-		{
-		    if (pStatus->hdr[i] >= 0)
-                sprintf(buf + strlen(buf),
-                        "eth%d : Send %u Recv %u Send Fail %u Recv Fail %u Missing %u\n", i + 1,
-                        pStatus->pktSent[i], pStatus->pktRecv[i],
-                        pStatus->pktSendFail[i], pStatus->pktRecvFail[i],
-                        pStatus->pktSent[i] - pStatus->pktRecv[i] - pStatus->pktRecvFail[i]);
-		}
-
-		eth_sender_resume();
+		if (stat_snap_read(pStatus->pSnap, &stats))
+			return;
+
+		eth_stats_format(pRep, &stats);
 	}
 }
 
@@ -4,7 +4,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 
-static void _temperature_print(TMPSNR_DEV_S * pDev, char * buf)
+static void _temperature_print(TMPSNR_DEV_S * pDev, REPORT * pRep)
 {
     char location[8] = {0};
     INT32 handler;
@@ -38,10 +38,10 @@ static void _temperature_print(TMPSNR_DEV_S * pDev, char * buf)
 
     DeviceRelease(handler);
 
-    sprintf(buf, "%s : %d.%d\t", location, temp / ratio, temp % ratio);
+    report_printf(pRep, "%s : %d.%d\t", location, temp / ratio, temp % ratio);
 }
 
-static void _voltage_print(VOLSNR_DEV_S * pDev, char * buf)
+static void _voltage_print(VOLSNR_DEV_S * pDev, REPORT * pRep)
 {
     INT32 hdr;
     UINT32 vol;
@@ -58,7 +58,7 @@ static void _voltage_print(VOLSNR_DEV_S * pDev, char * buf)
 
     ratio = ((float)abs(vol - pDev->normal_voltage) * 100) / (float)pDev->normal_voltage;
 
-    sprintf(buf, "%d/%d mV(%.2f%%)  ", vol, pDev->normal_voltage, ratio);
+    report_printf(pRep, "%d/%d mV(%.2f%%)  ", vol, pDev->normal_voltage, ratio);
 
     if ((ratio > 7) && (pDev->normal_voltage != 24000))
     {
@@ -80,7 +80,7 @@ static void _voltage_print(VOLSNR_DEV_S * pDev, char * buf)
     }
 }
 
-static void _uart_print(UART_DEV_S * pDev, char * buf)
+static void _uart_print(UART_DEV_S * pDev, REPORT * pRep)
 {
     INT32 hdr;
     UINT8 pBuf[128];
@@ -89,28 +89,28 @@ static void _uart_print(UART_DEV_S * pDev, char * buf)
     if (hdr < 0)
         return;
 
-    memset(buf, 0x55, 128);
+    memset(pBuf, 0x55, 128);
 
     if (UARTConfig(hdr, 9600, 0))
     {
         DeviceRelease(hdr);
-        sprintf(buf, "UART(%s) FAIL\n", pDev->name);
+        report_printf(pRep, "UART(%s) FAIL\n", pDev->name);
         return;
     }
 
     if (UARTSend(hdr, pBuf, 128) != 128)
     {
         DeviceRelease(hdr);
-        sprintf(buf, "UART(%s) FAIL\n", pDev->name);
+        report_printf(pRep, "UART(%s) FAIL\n", pDev->name);
         return;
     }
 
     DeviceRelease(hdr);
 
-    sprintf(buf, "UART(%s) OK\n", pDev->name);
+    report_printf(pRep, "UART(%s) OK\n", pDev->name);
 }
 
-static void rh_print(char * buf)
+static void rh_print(REPORT * pRep)
 {
     INT32 hdr;
     UINT32 rh;
@@ -126,10 +126,10 @@ static void rh_print(char * buf)
 
     DeviceRelease(hdr);
 
-    sprintf(buf, "RH : %d.%03d%%\t", rh / ratio, rh % ratio);
+    report_printf(pRep, "RH : %d.%03d%%\t", rh / ratio, rh % ratio);
 }
 
-static void fram_print(char * buf)
+static void fram_print(REPORT * pRep)
 {
     INT32 hdr;
     INT32 regRead, regWrite;
@@ -153,7 +153,7 @@ static void fram_print(char * buf)
     regWrite = rand() & 0xFF;
     if (MSRegWrite(hdr, 0, regWrite))
     {
-    	sprintf(buf, "FRAM : Write Fail\n");
+    	report_printf(pRep, "FRAM : Write Fail\n");
     	goto ends;
     }
 
@@ -161,25 +161,25 @@ static void fram_print(char * buf)
     regRead = MSRegRead(hdr, 0);
     if (regRead < 0)
     {
-        sprintf(buf, "FRAM : Read Fail\t");
+        report_printf(pRep, "FRAM : Read Fail\t");
         goto ends;
     }
 
     /* Verify */
     if (regRead != regWrite)
     {
-        sprintf(buf, "FRAM : Read != Write\t");
+        report_printf(pRep, "FRAM : Read != Write\t");
         goto ends;
     }
 
     /* good to go */
-    sprintf(buf, "FRAM : OK\t");
+    report_printf(pRep, "FRAM : OK\t");
 
 ends:
     DeviceRelease(hdr);
 }
 
-static void rtc_print(char * str)
+static void rtc_print(REPORT * pRep)
 {
     INT32 hdr;
     INT32 t;
@@ -192,17 +192,17 @@ static void rtc_print(char * str)
 
     if (TimeGet(hdr, &t))
     {
-        sprintf(str, "RTC : Failed\t");
+        report_printf(pRep, "RTC : Failed\t");
         goto ends;
     }
 
-    sprintf(str, "RTC : OK\t");
+    report_printf(pRep, "RTC : OK\t");
 
 ends:
     DeviceRelease(hdr);
 }
 
-static void irigb_print(char * str)
+static void irigb_print(REPORT * pRep)
 {
     INT32 hdr;
     void * pDev = NULL;
@@ -215,9 +215,9 @@ static void irigb_print(char * str)
             return;
 
         if (IRIGBStatus(hdr))
-            sprintf(str, "IRIGB : Failed\t");
+            report_printf(pRep, "IRIGB : Failed\t");
         else
-            sprintf(str, "IRIGB : OK\t");
+            report_printf(pRep, "IRIGB : OK\t");
     }
     else
     {
@@ -227,15 +227,15 @@ static void irigb_print(char * str)
             return;
 
         if (DateTimeStatus(hdr))
-            sprintf(str, "IRIGB : Failed\t");
+            report_printf(pRep, "IRIGB : Failed\t");
         else
-            sprintf(str, "IRIGB : OK\t");
+            report_printf(pRep, "IRIGB : OK\t");
     }
 
     DeviceRelease(hdr);
 }
 
-static void type_print(UINT16 type, char * buf, FUNCPTR _print)
+static void type_print(UINT16 type, REPORT * pRep, FUNCPTR _print)
 {
 	void * pDev = NULL;
 	int called = 0;
@@ -246,15 +246,15 @@ static void type_print(UINT16 type, char * buf, FUNCPTR _print)
 		if (pDev)
 		{
 			called = 1;
-			_print(pDev, buf + strlen(buf));
+			_print(pDev, pRep);
 		}
 	}while(pDev != NULL);
 
 	if (called)
-		sprintf(buf + strlen(buf), "\n");
+		report_printf(pRep, "\n");
 }
 
-static void fs_test(const char * path, char * str)
+static void fs_test(const char * path, REPORT * pRep)
 {
     int fd;
     char filename[32];
@@ -266,7 +266,7 @@ static void fs_test(const char * path, char * str)
     fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
     if (fd <= 0)
     {
-        sprintf(str, "%s : Open Fail\t", path);
+        report_printf(pRep, "%s : Open Fail\t", path);
         return;
     }
 
@@ -275,22 +275,22 @@ static void fs_test(const char * path, char * str)
     /* see if the file is really created */
     if (stat(filename, &s))
     {
-        sprintf(str, "%s : Create Fail\t", path);
+        report_printf(pRep, "%s : Create Fail\t", path);
         return;
     }
 
     /* remove this file */
     if (remove(filename))
     {
-        sprintf(str, "%s : Remove Fail\t", path);
+        report_printf(pRep, "%s : Remove Fail\t", path);
         return;
     }
 
-    sprintf(str, "%s : OK\t", path);
+    report_printf(pRep, "%s : OK\t", path);
 }
 
 #if 0
-static void serial_test(char * str)
+static void serial_test(REPORT * pRep)
 {
     int fd;
     char ch[128];
@@ -298,7 +298,7 @@ static void serial_test(char * str)
     fd = open("/tyCo/1", O_WRONLY | O_NOCTTY | O_NONBLOCK, 0666);
     if (fd < 0)
     {
-        sprintf(str, "RS232 : Open Fail\t");
+        report_printf(pRep, "RS232 : Open Fail\t");
         return;
     }
 
@@ -306,17 +306,17 @@ static void serial_test(char * str)
 
     if (write(fd, ch, 128) != 128)
     {
-        sprintf(str, "RS232 : Write Fail\t");
+        report_printf(pRep, "RS232 : Write Fail\t");
         goto ends;
     }
 
-    sprintf(str, "RS232 : OK\t");
+    report_printf(pRep, "RS232 : OK\t");
 
 ends:
     close(fd);
 }
 #else
-static void serial_test(char * str) {}
+static void serial_test(REPORT * pRep) {}
 #endif
 
 static void func_start(void)
@@ -326,24 +326,24 @@ static void func_start(void)
         hsb_remote_reg_config(addr_get(), 0x4, 0x2AA);
 }
 
-static void func_show(char * buf)
+static void func_show(REPORT * pRep)
 {
-	sprintf(buf, "\n********** BOARD **********\n");
-	type_print(SAC_DEVICE_TYPE_TEMP_SENSOR, buf + strlen(buf),
+	report_printf(pRep, "\n********** BOARD **********\n");
+	type_print(SAC_DEVICE_TYPE_TEMP_SENSOR, pRep,
 			(FUNCPTR)_temperature_print);
-	type_print(SAC_DEVICE_TYPE_VOL_SENSOR, buf + strlen(buf),
+	type_print(SAC_DEVICE_TYPE_VOL_SENSOR, pRep,
 			(FUNCPTR)_voltage_print);
-	type_print(SAC_DEVICE_TYPE_UART, buf + strlen(buf),
+	type_print(SAC_DEVICE_TYPE_UART, pRep,
 	        (FUNCPTR)_uart_print);
-	rh_print(buf + strlen(buf));
-	fram_print(buf + strlen(buf));
-	rtc_print(buf + strlen(buf));
-	irigb_print(buf + strlen(buf));
-	fs_test("tffs", buf + strlen(buf));
-	fs_test("set", buf + strlen(buf));
-	fs_test("data", buf + strlen(buf));
-	serial_test(buf + strlen(buf));
-	sprintf(buf + strlen(buf), "\n");
+	rh_print(pRep);
+	fram_print(pRep);
+	rtc_print(pRep);
+	irigb_print(pRep);
+	fs_test("tffs", pRep);
+	fs_test("set", pRep);
+	fs_test("data", pRep);
+	serial_test(pRep);
+	report_printf(pRep, "\n");
 }
 
 MODULE_REGISTER(func);
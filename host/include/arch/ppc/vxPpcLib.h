@@ -0,0 +1,10 @@
+/* Host shim for <arch/ppc/vxPpcLib.h> */
+#ifndef __HOST_VXPPCLIB_H
+#define __HOST_VXPPCLIB_H
+
+#include <vxWorks.h>
+
+/* Time base is emulated with CLOCK_MONOTONIC, in nanoseconds */
+extern void vxTimeBaseGet(UINT32 * pTbu, UINT32 * pTbl);
+
+#endif /* __HOST_VXPPCLIB_H */
@@ -0,0 +1,5 @@
+/* Host shim for <drv/wdb/wdbEndPktDrv.h>, nothing used from it */
+#ifndef __HOST_WDBENDPKTDRV_H
+#define __HOST_WDBENDPKTDRV_H
+
+#endif /* __HOST_WDBENDPKTDRV_H */
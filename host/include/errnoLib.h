@@ -0,0 +1,7 @@
+/* Host shim for <errnoLib.h> */
+#ifndef __HOST_ERRNOLIB_H
+#define __HOST_ERRNOLIB_H
+
+#include <errno.h>
+
+#endif /* __HOST_ERRNOLIB_H */
@@ -0,0 +1,5 @@
+/* Host shim for <inetLib.h>, nothing used from it */
+#ifndef __HOST_INETLIB_H
+#define __HOST_INETLIB_H
+
+#endif /* __HOST_INETLIB_H */
@@ -0,0 +1,5 @@
+/* Host shim for <isrDeferLib.h>, nothing used from it */
+#ifndef __HOST_ISRDEFERLIB_H
+#define __HOST_ISRDEFERLIB_H
+
+#endif /* __HOST_ISRDEFERLIB_H */
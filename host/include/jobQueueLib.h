@@ -0,0 +1,23 @@
+/* Host shim for <jobQueueLib.h> */
+#ifndef __HOST_JOBQUEUELIB_H
+#define __HOST_JOBQUEUELIB_H
+
+#include <vxWorks.h>
+
+typedef struct qjob
+{
+    struct qjob * next;
+    void (*func)(void * arg);
+    int pri;
+    int queued;
+} QJOB;
+
+typedef struct sim_job_queue * JOB_QUEUE_ID;
+
+#define QJOB_SET_PRI(pJob, p)   ((pJob)->pri = (p))
+
+extern JOB_QUEUE_ID jobQueueCreate(void * pJobPool);
+extern STATUS jobQueuePost(JOB_QUEUE_ID qId, QJOB * pJob);
+extern STATUS jobQueueProcess(JOB_QUEUE_ID qId);
+
+#endif /* __HOST_JOBQUEUELIB_H */
@@ -0,0 +1,25 @@
+/* Host shim for <lstLib.h> */
+#ifndef __HOST_LSTLIB_H
+#define __HOST_LSTLIB_H
+
+#include <vxWorks.h>
+
+typedef struct node
+{
+    struct node * next;
+    struct node * previous;
+} NODE;
+
+typedef struct
+{
+    NODE node;
+    int count;
+} LIST;
+
+extern void lstInit(LIST * pList);
+extern void lstAdd(LIST * pList, NODE * pNode);
+extern NODE * lstFirst(LIST * pList);
+extern NODE * lstNext(NODE * pNode);
+extern int lstCount(LIST * pList);
+
+#endif /* __HOST_LSTLIB_H */
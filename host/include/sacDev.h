@@ -0,0 +1,228 @@
+/*
+ * Host shim for <sacDev.h>
+ *
+ * Declares the subset of the SAC device layer used by TestFramework. The
+ * descriptors and calls are implemented by the simulated device layer in
+ * sacsim.c.
+ */
+#ifndef __HOST_SACDEV_H
+#define __HOST_SACDEV_H
+
+#include <vxWorks.h>
+#include <errno.h>
+
+/* Byte order helpers */
+#define cpu_to_be32(x)      htobe32(x)
+#define be32_to_cpu(x)      be32toh(x)
+#define cpu_to_le32(x)      htole32(x)
+#define le32_to_cpu(x)      le32toh(x)
+#define cpu_to_be16(x)      htobe16(x)
+#define be16_to_cpu(x)      be16toh(x)
+#if _BYTE_ORDER == _LITTLE_ENDIAN
+#define tole(x)             (x)
+#else
+#define tole(x)             ((((x) & 0x000000ffUL) << 24) | \
+                             (((x) & 0x0000ff00UL) <<  8) | \
+                             (((x) & 0x00ff0000UL) >>  8) | \
+                             (((x) & 0xff000000UL) >> 24))
+#endif
+
+/* FPGA registers live in the simulated FPGA */
+extern UINT32 sim_fpga_reg_read(UINT32 addr);
+extern void sim_fpga_reg_write(UINT32 addr, UINT32 val);
+#define FPGA_REG_READ(addr)         sim_fpga_reg_read(addr)
+#define FPGA_REG_WRITE(addr, val)   sim_fpga_reg_write(addr, val)
+
+/* Device types */
+enum
+{
+    SAC_DEVICE_TYPE_ETHERNET = 1,
+    SAC_DEVICE_TYPE_STATUS,
+    SAC_DEVICE_TYPE_CANHCB,
+    SAC_DEVICE_TYPE_FPGA,
+    SAC_DEVICE_TYPE_INDICATOR,
+    SAC_DEVICE_TYPE_TIMER,
+    SAC_DEVICE_TYPE_ION,
+    SAC_DEVICE_TYPE_RTC,
+    SAC_DEVICE_TYPE_TEMP_SENSOR,
+    SAC_DEVICE_TYPE_VOL_SENSOR,
+    SAC_DEVICE_TYPE_UART,
+    SAC_DEVICE_TYPE_RH_SENSOR,
+    SAC_DEVICE_TYPE_MEMSPACE,
+    SAC_DEVICE_TYPE_IRIGB,
+    SAC_DEVICE_TYPE_DATETIME,
+    SAC_DEVICE_TYPE_MAX
+};
+
+typedef struct sac_dev_header
+{
+    struct sac_dev_header * next;
+    UINT16  type;
+    UINT16  exclusive;
+    INT32   users;
+    void *  priv;
+} SAC_DEV_HEADER, * SAC_DEV_HEADER_ID;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    char    name[16];
+} ETHERNET_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    UINT32  type;
+} STATUS_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    UINT8   addr;
+} FPGA_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    char    color[16];
+} INDICATOR_DEV_S;
+
+#define SACDEV_TMPSNR_LOC_PROCCESSOR    0
+#define SACDEV_TMPSNR_LOC_BOARD         1
+#define SACDEV_TMPSNR_LOC_AMBIENT       2
+#define SACDEV_TMPSNR_LOC_FPGA          3
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    UINT32  location;
+} TMPSNR_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    UINT32  normal_voltage;
+} VOLSNR_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    char    name[16];
+} UART_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+} RHSNR_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+    char    devName[16];
+} MEMSPACE_DEV_S;
+
+typedef struct
+{
+    SAC_DEV_HEADER header;
+} RTC_DEV_S;
+
+/* Device description and handler management */
+extern void * DescriptionGetByType(UINT16 type, void * pPrev);
+extern INT32 DeviceRequest(void * pDev);
+extern INT32 DeviceRelease(INT32 fd);
+
+/* Ethernet */
+typedef BOOL (*ETHERNET_RECV_HOOK)(void * pDev, UINT8 * pBuf, UINT32 bufLen);
+extern INT32 EthernetIPSet(INT32 fd, char * ip);
+extern INT32 EthernetMACGet(INT32 fd, char * mac);
+extern INT32 EthernetSendPkt(INT32 fd, UINT8 * pkt, UINT32 len);
+extern INT32 EthernetRecvHook(INT32 fd, ETHERNET_RECV_HOOK hook);
+extern INT32 EthernetHookEnable(INT32 fd);
+extern INT32 EthernetHookDisable(INT32 fd);
+extern INT32 EthernetPktDrop(INT32 fd, UINT32 count);
+extern INT32 EthernetRecvPoll(INT32 fd, UINT32 * pLimit);
+
+/* Indicator */
+extern INT32 LightOn(INT32 fd);
+extern INT32 LightOff(INT32 fd);
+
+/* RTC and date time */
+extern INT32 TimeGet(INT32 fd, INT32 * pTime);
+extern INT32 IRIGBStatus(INT32 fd);
+extern INT32 DateTimeStatus(INT32 fd);
+
+/* Status */
+#define SAC_STATUS_ASSERT       1
+#define SAC_STATUS_DESSERT      0
+#define SAC_STATUS_QD           0
+#define SAC_STATUS_QD_RET       1
+#define SAC_STATUS_SQD          2
+#define SAC_STATUS_SQD_RET      3
+extern INT32 StatusAssert(INT32 fd);
+extern INT32 StatusDessert(INT32 fd);
+extern INT32 StatusGet(INT32 fd);
+
+/* Timer */
+extern INT32 TimerDisable(INT32 fd);
+extern INT32 TimerEnable(INT32 fd);
+extern INT32 TimerFreqSet(INT32 fd, UINT32 freq);
+extern INT32 TimerISRSet(INT32 fd, VOIDFUNCPTR isr, _Vx_usr_arg_t arg);
+
+/* Sensors and memory spaces */
+extern INT32 TemperatureGet(INT32 fd, INT32 * pTemp, UINT32 * pRatio);
+extern INT32 VoltageGet(INT32 fd, UINT32 * pVol);
+extern INT32 RHGet(INT32 fd, UINT32 * pRH, UINT32 * pRatio);
+extern INT32 MSRegWrite(INT32 fd, UINT32 addr, UINT32 val);
+extern INT32 MSRegRead(INT32 fd, UINT32 addr);
+extern INT32 UARTConfig(INT32 fd, UINT32 baud, UINT32 opt);
+extern INT32 UARTSend(INT32 fd, UINT8 * buf, UINT32 len);
+
+/* CAN-HCB */
+typedef struct
+{
+    UINT16  SRC;
+    UINT16  DST;
+    UINT32  DLC;
+    UINT8 * pkt_buf;
+} CANHCB_PKT_S;
+
+#define SAC_CANHCB_STATUS_BIT_ERR           0x01
+#define SAC_CANHCB_STATUS_TIMING_ERR        0x02
+#define SAC_CANHCB_STATUS_ARBITRATION_FAIL  0x04
+#define SAC_CANHCB_STATUS_CODE_ERR          0x08
+#define SAC_CANHCB_STATUS_LEN_CRC_ERR       0x10
+
+typedef CANHCB_PKT_S * (*CANHCB_RECV_HOOK)(UINT32 src);
+extern INT32 CANHCBStatusGet(INT32 fd);
+extern INT32 CANHCBHookRegister(INT32 fd, CANHCB_RECV_HOOK hook);
+extern INT32 CANHCBPktPoll(INT32 fd);
+extern INT32 CANHCBPktSend(INT32 fd, CANHCB_PKT_S * pPkt);
+
+/* ION */
+typedef struct
+{
+    UINT8   SRC;
+    UINT8   DST;
+    UINT8   PRI;
+    UINT8   RP;
+    UINT32  DLC;
+    UINT8 * pkt_buf;
+} ION_PKT_S;
+
+typedef struct
+{
+    UINT32  ACK_ERROR;
+    UINT32  BIT_ERROR;
+    UINT32  CRC_ERROR;
+    UINT32  FORMAT_ERROR;
+    UINT32  INCON_ERROR;
+    UINT32  SEND_ERROR;
+    UINT32  STUFF_ERROR;
+} ION_COUNTER_S;
+
+typedef ION_PKT_S * (*ION_RECV_HOOK)(UINT8 type);
+extern INT32 IONHookRegister(INT32 fd, ION_RECV_HOOK hook);
+extern INT32 IONPktPoll(INT32 fd);
+extern INT32 IONPktSend(INT32 fd, ION_PKT_S * pPkt);
+
+#endif /* __HOST_SACDEV_H */
@@ -0,0 +1,7 @@
+/* Host shim for <sacDevBus.h> */
+#ifndef __HOST_SACDEVBUS_H
+#define __HOST_SACDEVBUS_H
+
+#include <sacDev.h>
+
+#endif /* __HOST_SACDEVBUS_H */
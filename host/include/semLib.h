@@ -0,0 +1,27 @@
+/* Host shim for <semLib.h> */
+#ifndef __HOST_SEMLIB_H
+#define __HOST_SEMLIB_H
+
+#include <vxWorks.h>
+
+typedef struct sim_semaphore * SEM_ID;
+
+typedef enum
+{
+    SEM_EMPTY,
+    SEM_FULL
+} SEM_B_STATE;
+
+#define SEM_Q_FIFO              0x00
+#define SEM_Q_PRIORITY          0x01
+#define SEM_DELETE_SAFE         0x04
+#define SEM_INVERSION_SAFE      0x08
+
+extern SEM_ID semBCreate(int options, SEM_B_STATE initialState);
+extern SEM_ID semCCreate(int options, int initialCount);
+extern SEM_ID semMCreate(int options);
+extern STATUS semTake(SEM_ID semId, int timeout);
+extern STATUS semGive(SEM_ID semId);
+extern STATUS semDelete(SEM_ID semId);
+
+#endif /* __HOST_SEMLIB_H */
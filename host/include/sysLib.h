@@ -0,0 +1,9 @@
+/* Host shim for <sysLib.h> */
+#ifndef __HOST_SYSLIB_H
+#define __HOST_SYSLIB_H
+
+#include <vxWorks.h>
+
+extern int sysClkRateGet(void);
+
+#endif /* __HOST_SYSLIB_H */
@@ -0,0 +1,18 @@
+/* Host shim for <taskLib.h> */
+#ifndef __HOST_TASKLIB_H
+#define __HOST_TASKLIB_H
+
+#include <vxWorks.h>
+
+#define VX_FP_TASK      0x0008
+
+extern TASK_ID taskSpawn(char * name, int priority, int options, int stackSize,
+        FUNCPTR entryPt, _Vx_usr_arg_t arg1, _Vx_usr_arg_t arg2,
+        _Vx_usr_arg_t arg3, _Vx_usr_arg_t arg4, _Vx_usr_arg_t arg5,
+        _Vx_usr_arg_t arg6, _Vx_usr_arg_t arg7, _Vx_usr_arg_t arg8,
+        _Vx_usr_arg_t arg9, _Vx_usr_arg_t arg10);
+extern STATUS taskDelay(int ticks);
+extern TASK_ID taskIdSelf(void);
+extern STATUS taskPriorityGet(TASK_ID tid, int * pPriority);
+
+#endif /* __HOST_TASKLIB_H */
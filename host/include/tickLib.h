@@ -0,0 +1,9 @@
+/* Host shim for <tickLib.h> */
+#ifndef __HOST_TICKLIB_H
+#define __HOST_TICKLIB_H
+
+#include <vxWorks.h>
+
+extern ULONG tickGet(void);
+
+#endif /* __HOST_TICKLIB_H */
@@ -0,0 +1,11 @@
+/* Host shim for <vxAtomicLib.h> */
+#ifndef __HOST_VXATOMICLIB_H
+#define __HOST_VXATOMICLIB_H
+
+#include <vxWorks.h>
+
+#define VX_MEM_BARRIER_R()      __sync_synchronize()
+#define VX_MEM_BARRIER_W()      __sync_synchronize()
+#define VX_MEM_BARRIER_RW()     __sync_synchronize()
+
+#endif /* __HOST_VXATOMICLIB_H */
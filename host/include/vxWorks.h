@@ -0,0 +1,69 @@
+/*
+ * Host shim for <vxWorks.h>
+ *
+ * Only the subset of the VxWorks kernel API used by TestFramework is
+ * provided. Everything is backed by vxsim.c.
+ */
+#ifndef __HOST_VXWORKS_H
+#define __HOST_VXWORKS_H
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <malloc.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <endian.h>
+
+typedef uint8_t     UINT8;
+typedef uint16_t    UINT16;
+typedef uint32_t    UINT32;
+typedef unsigned long long UINT64;
+typedef int8_t      INT8;
+typedef int16_t     INT16;
+typedef int32_t     INT32;
+typedef long long   INT64;
+typedef unsigned long ULONG;
+typedef int         BOOL;
+typedef int         STATUS;
+typedef int         (*FUNCPTR)();
+typedef void        (*VOIDFUNCPTR)();
+typedef long        TASK_ID;
+typedef long        _Vx_usr_arg_t;
+
+#ifndef TRUE
+#define TRUE        1
+#define FALSE       0
+#endif
+
+#define OK          0
+#define ERROR       (-1)
+
+#define FOREVER     for (;;)
+
+#define WAIT_FOREVER    (-1)
+#define NO_WAIT         0
+
+#define TASK_ID_ERROR   ((TASK_ID)-1)
+
+#define _LITTLE_ENDIAN  1234
+#define _BIG_ENDIAN     4321
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define _BYTE_ORDER     _LITTLE_ENDIAN
+#else
+#define _BYTE_ORDER     _BIG_ENDIAN
+#endif
+
+/* logLib */
+extern int logMsg(char * fmt, _Vx_usr_arg_t a1, _Vx_usr_arg_t a2,
+        _Vx_usr_arg_t a3, _Vx_usr_arg_t a4, _Vx_usr_arg_t a5, _Vx_usr_arg_t a6);
+extern STATUS logFdAdd(int fd);
+extern STATUS logFdDelete(int fd);
+
+/* The host clock is left alone */
+extern int sim_settimeofday(const struct timeval * tv, const void * tz);
+#define settimeofday    sim_settimeofday
+
+#endif /* __HOST_VXWORKS_H */
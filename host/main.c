@@ -0,0 +1,287 @@
+/*
+ * Host entry of TestFramework
+ *
+ * Builds the simulated board, runs the shell commands given with -x, starts
+ * the test like rc.d does and prints the report after the run. -p commands
+ * run once the report is printed.
+ */
+#include "lib.h"
+#include "sim.h"
+
+#include <unistd.h>
+
+#define SIM_CMD_MAX     16
+#define SIM_ARG_MAX     4
+
+extern void test_start(int delay);
+extern void test_show(void);
+extern int hsb_display_sfp_pkt(uint32_t sfp_count);
+extern void rand_bench(void);
+extern void hsb_lat_reset(void);
+extern int hsb_rate_set(uint32_t bandwidth, uint32_t sfp_count);
+extern int hsb_sweep_add(uint32_t bandwidth, uint32_t sfp_count);
+extern void hsb_sweep_clear(void);
+extern int hsb_sweep_start(void);
+extern UINT32 timeBaseFreq;
+extern int ion_di_lat_test(UINT8 addr, UINT32 count);
+extern int ion_di_journal_show(UINT32 count);
+extern UINT32 ionRecvMode;
+extern UINT32 ionRecvFreq;
+extern UINT32 ionRttTimeout;
+extern UINT32 ionPollRate;
+extern UINT32 ionStatsPeriod;
+extern UINT32 ionPollWindow;
+extern UINT32 ionBusRate;
+extern UINT32 ionAliveTimeout;
+extern UINT32 canhcbBurst;
+extern UINT32 canhcbSched;
+extern int eth_rate_set(UINT32 port, UINT32 mbps, UINT32 burst);
+extern int canhcb_dst_add(UINT32 addr, UINT32 weight);
+extern void canhcb_dst_clear(void);
+extern UINT32 svFwdBatch;
+
+/* Shell variables of the modules */
+extern uint32_t hsbBandwidth;
+extern uint32_t hsbSfpCount;
+extern uint32_t hsbSweepDwell;
+extern uint32_t hsbPoolSize;
+extern uint32_t hsbErrSample;
+extern UINT32 statLogSize;
+extern UINT32 statLogKeyframe;
+extern UINT32 statLogFlushSec;
+
+typedef struct sim_sym
+{
+    const char * name;
+    void *  addr;
+    BOOL    func;
+} SIM_SYM;
+
+#define SIM_FUNC(f)     { #f, (void *)f, TRUE }
+#define SIM_VAR(v)      { #v, (void *)&v, FALSE }
+
+static SIM_SYM simSyms[] =
+{
+    SIM_FUNC(cksum_bench),
+    SIM_FUNC(cksum_engine_set),
+    SIM_FUNC(fletcher_bench),
+    SIM_FUNC(fletcher_engine_set),
+    SIM_FUNC(eth_srcmac_bench),
+    SIM_FUNC(eth_srcmac_invalidate),
+    SIM_FUNC(rand_bench),
+    SIM_FUNC(report_bench),
+    SIM_FUNC(stat_snap_test),
+    SIM_FUNC(statlog_flush),
+    SIM_FUNC(statlog_info),
+    SIM_FUNC(statlog_show),
+    SIM_FUNC(hsb_display_sfp_pkt),
+    SIM_FUNC(hsb_lat_reset),
+    SIM_FUNC(hsb_rate_set),
+    SIM_FUNC(hsb_sweep_add),
+    SIM_FUNC(hsb_sweep_clear),
+    SIM_FUNC(hsb_sweep_start),
+    SIM_FUNC(canhcb_dst_add),
+    SIM_FUNC(canhcb_dst_clear),
+    SIM_FUNC(eth_rate_set),
+    SIM_FUNC(ion_di_lat_test),
+    SIM_FUNC(ion_di_journal_show),
+    SIM_FUNC(test_show),
+    SIM_FUNC(sim_info),
+    SIM_FUNC(sim_di_toggle),
+    SIM_FUNC(sim_iom_down),
+    SIM_VAR(randSeed),
+    SIM_VAR(simHcbCrcLeak),
+    SIM_VAR(simHcbNodes),
+    SIM_VAR(canhcbSched),
+    SIM_VAR(canhcbBurst),
+    SIM_VAR(timeBaseFreq),
+    SIM_VAR(hsbBandwidth),
+    SIM_VAR(hsbSfpCount),
+    SIM_VAR(hsbSweepDwell),
+    SIM_VAR(ionRecvMode),
+    SIM_VAR(ionRecvFreq),
+    SIM_VAR(ionRttTimeout),
+    SIM_VAR(ionPollRate),
+    SIM_VAR(ionStatsPeriod),
+    SIM_VAR(ionPollWindow),
+    SIM_VAR(ionBusRate),
+    SIM_VAR(ionAliveTimeout),
+    SIM_VAR(svFwdBatch),
+    SIM_VAR(hsbPoolSize),
+    SIM_VAR(hsbErrSample),
+    SIM_VAR(statLogSize),
+    SIM_VAR(statLogKeyframe),
+    SIM_VAR(statLogFlushSec),
+};
+
+/*
+ * Run one shell style command, "func arg ..." calls a function with numbers
+ * or strings, "var = value" sets a UINT32 variable
+ */
+static int sim_cmd(char * cmd)
+{
+    _Vx_usr_arg_t args[SIM_ARG_MAX] = {0};
+    char * tok, * save, * end;
+    SIM_SYM * pSym = NULL;
+    int i, argc = 0;
+    long ret;
+
+    tok = strtok_r(cmd, " \t=,()", &save);
+    if (tok == NULL)
+        return -EINVAL;
+
+    for (i = 0; i < sizeof(simSyms) / sizeof(simSyms[0]); i++)
+    {
+        if (strcmp(simSyms[i].name, tok) == 0)
+            pSym = &simSyms[i];
+    }
+    if (pSym == NULL)
+    {
+        printf("%s : not found\n", tok);
+        return -ENOENT;
+    }
+
+    while ((argc < SIM_ARG_MAX) && (tok = strtok_r(NULL, " \t=,()", &save)) != NULL)
+    {
+        args[argc] = strtol(tok, &end, 0);
+        if (*end != '\0')
+            args[argc] = (_Vx_usr_arg_t)tok;
+        argc++;
+    }
+
+    if (!pSym->func)
+    {
+        if (argc)
+            *(UINT32 *)pSym->addr = args[0];
+        printf("%s = %u\n", pSym->name, *(UINT32 *)pSym->addr);
+        return 0;
+    }
+
+    ret = ((long (*)(_Vx_usr_arg_t, _Vx_usr_arg_t, _Vx_usr_arg_t,
+            _Vx_usr_arg_t))pSym->addr)(args[0], args[1], args[2], args[3]);
+    printf("value = %ld = 0x%lx\n", ret, ret);
+    return 0;
+}
+
+static int sim_bus_arg(char * arg)
+{
+    char * eq = strchr(arg, '=');
+    double loss, ber = 0;
+    unsigned rate = 0;
+
+    if (eq == NULL)
+        return -EINVAL;
+    *eq = '\0';
+    if (sscanf(eq + 1, "%lf,%lf,%u", &loss, &ber, &rate) < 1)
+        return -EINVAL;
+
+    return sim_bus_set(arg, loss, ber, rate);
+}
+
+static void usage(const char * prog)
+{
+    printf("usage: %s [options]\n"
+           "  -b board      board name, NPS-HMI (default) or NPS-CPU\n"
+           "  -a addr       FPGA address, default 1\n"
+           "  -t seconds    run the test for seconds, 0 runs the commands only\n"
+           "  -d delay      periodic report delay in seconds\n"
+           "  -s seed       loss and bit error seed\n"
+           "  -l bus=loss[,ber[,rate]]\n"
+           "                impair hsb, hcb, ion, eth, manage, sv or debug,\n"
+           "                rate limits the line to rate bps\n"
+           "  -n nodes      HSB nodes echoing the SFP packets, default 12\n"
+           "  -m nodes      extra manage nodes, default 2\n"
+           "  -i mask       IOMs present on ION, default 0xE\n"
+           "  -v rate       SV frames per second, default 1200\n"
+           "  -x cmd        shell command run before the test starts\n"
+           "  -p cmd        shell command run after the report\n",
+           prog);
+}
+
+int main(int argc, char * argv[])
+{
+    char * preCmd[SIM_CMD_MAX], * postCmd[SIM_CMD_MAX], * busArg[SIM_CMD_MAX];
+    int preCnt = 0, postCnt = 0, busCnt = 0;
+    int seconds = 20, delay = 0;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "b:a:t:d:s:l:n:m:i:v:x:p:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            simBoard = optarg;
+            break;
+        case 'a':
+            simAddr = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            seconds = strtol(optarg, NULL, 0);
+            break;
+        case 'd':
+            delay = strtol(optarg, NULL, 0);
+            break;
+        case 's':
+            simSeed = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            if (busCnt < SIM_CMD_MAX)
+                busArg[busCnt++] = optarg;
+            break;
+        case 'n':
+            simHsbNodes = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            simManageNodes = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            simIoms = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            simSvRate = strtoul(optarg, NULL, 0);
+            break;
+        case 'x':
+            if (preCnt < SIM_CMD_MAX)
+                preCmd[preCnt++] = optarg;
+            break;
+        case 'p':
+            if (postCnt < SIM_CMD_MAX)
+                postCmd[postCnt++] = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    sim_clock_init();
+    sim_init();
+
+    for (i = 0; i < busCnt; i++)
+    {
+        if (sim_bus_arg(busArg[i]))
+        {
+            printf("bad bus impairment %s\n", busArg[i]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < preCnt; i++)
+        sim_cmd(preCmd[i]);
+
+    if (seconds > 0)
+    {
+        /* test_start() waits 500 ticks before the modules start */
+        test_start(delay);
+        taskDelay(500 + seconds * sysClkRateGet());
+        test_show();
+        taskDelay(2 * sysClkRateGet());
+    }
+
+    for (i = 0; i < postCnt; i++)
+        sim_cmd(postCmd[i]);
+
+    fflush(stdout);
+    _exit(0);
+}
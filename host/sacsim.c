@@ -0,0 +1,1464 @@
+/*
+ * Simulated SAC device layer for the host build
+ *
+ * Every bus loops back inside the process. Frames can be lost or hit by bit
+ * errors, both sampled as geometric skips so a low rate costs nothing per
+ * frame. Where the hardware checks a CRC (HSB, HCB, ION) a hit frame is
+ * dropped and the error latched, Ethernet frames are delivered corrupted.
+ *
+ * Receive hooks are called without simLock held, they may send.
+ */
+#include <vxWorks.h>
+#include <sacDev.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "sim.h"
+
+#define SIM_FD_MAX          64
+#define SIM_QUEUE_MAX       4096        /* frames per receive queue */
+#define SIM_POLL_BATCH      32          /* EthernetRecvPoll() without limit */
+#define SIM_ETH_LEN_MAX     1600
+#define SIM_TX_FIFO         4096        /* bytes queued on a rate limited bus */
+#define SIM_HCB_DLC_MAX     500
+#define SIM_ION_DLC_MAX     256
+#define SIM_TIMER_CNT       8
+#define SIM_IOM_NUM         32
+#define SIM_ION_REPORT_NS   1000000000ULL   /* heartbeat and DI period */
+
+#define SIM_HSB_REG_ERR         0x40000300
+#define SIM_HSB_REG_RECV_CNT    0x40000304
+#define SIM_HSB_REG_SEND_CNT    0x40000308
+
+const char * simBoard = "NPS-HMI";
+UINT8 simAddr = 1;
+UINT32 simSeed = 1;
+UINT32 simHsbNodes = 12;
+UINT32 simManageNodes = 2;
+UINT32 simIoms = 0x0000000E;
+UINT32 simHcbCrcLeak = 0;
+UINT32 simHcbNodes = 0;
+UINT32 simSvRate = 1200;
+
+typedef struct sim_frame
+{
+    struct sim_frame * next;
+    UINT8   src;
+    UINT8   rp;
+    UINT16  dst;
+    UINT32  len;
+    UINT8   data[];
+} SIM_FRAME;
+
+typedef struct sim_queue
+{
+    SIM_FRAME * head;
+    SIM_FRAME * tail;
+    UINT32  count;
+} SIM_QUEUE;
+
+typedef struct sim_bus
+{
+    const char * name;
+    double  loss;           /* frame loss probability */
+    double  ber;            /* bit error rate */
+    UINT64  lossSkip;       /* frames passing before the next loss */
+    UINT64  bitSkip;        /* bits passing before the next bit error */
+    UINT64  rand;
+    UINT32  sent;
+    UINT32  delivered;
+    UINT32  lost;
+    UINT32  corrupted;
+    UINT32  overflow;
+    UINT32  rate;           /* line rate in bps, 0 for unlimited */
+    UINT64  busyUntil;      /* ns the transmit FIFO drains at */
+    UINT32  busy;           /* sends refused with a full FIFO */
+} SIM_BUS;
+
+enum
+{
+    SIM_BUS_HSB,
+    SIM_BUS_HCB,
+    SIM_BUS_ION,
+    SIM_BUS_ETH,
+    SIM_BUS_MANAGE,
+    SIM_BUS_SV,
+    SIM_BUS_DEBUG,
+    SIM_BUS_CNT
+};
+
+enum
+{
+    SIM_PASS,
+    SIM_LOST,
+    SIM_CORRUPT
+};
+
+typedef struct sim_eth
+{
+    ETHERNET_DEV_S dev;
+    SIM_BUS *   pBus;
+    void        (*send)(struct sim_eth *, const UINT8 *, UINT32);
+    void        (*gen)(struct sim_eth *);
+    SIM_QUEUE   rxQueue;
+    ETHERNET_RECV_HOOK hook;
+    BOOL        hookOn;
+    UINT8       mac[6];
+    BOOL        genOn;
+    UINT64      genStart;
+    UINT64      genCount;
+} SIM_ETH;
+
+typedef struct sim_status
+{
+    STATUS_DEV_S dev;
+    INT32       state;
+} SIM_STATUS;
+
+typedef struct sim_led
+{
+    INDICATOR_DEV_S dev;
+    BOOL        on;
+} SIM_LED;
+
+typedef struct sim_timer
+{
+    SAC_DEV_HEADER header;
+    pthread_t   thread;
+    BOOL        running;
+    BOOL        enabled;
+    UINT32      freq;
+    UINT32      gen;        /* bumped on every reconfiguration */
+    VOIDFUNCPTR isr;
+    _Vx_usr_arg_t arg;
+} SIM_TIMER;
+
+typedef struct sim_hcb
+{
+    SAC_DEV_HEADER header;
+    SIM_QUEUE   rxQueue;
+    CANHCB_RECV_HOOK hook;
+    UINT32      status;     /* latched, cleared by CANHCBStatusGet() */
+} SIM_HCB;
+
+typedef struct sim_ion
+{
+    SAC_DEV_HEADER header;
+    SIM_QUEUE   rxQueue;
+    ION_RECV_HOOK hook;
+    UINT32      started;    /* IOMs told to start */
+    UINT32      diPending;  /* IOMs with a DI change to report */
+    UINT64      nextReport;
+    UINT8       diSeq;
+    UINT8       DI[SIM_IOM_NUM][8];
+    UINT64      downFrom[SIM_IOM_NUM];  /* IOM powered off in between */
+    UINT64      downUntil[SIM_IOM_NUM];
+} SIM_ION;
+
+typedef struct sim_temp
+{
+    TMPSNR_DEV_S dev;
+    INT32       temp;       /* 0.1 degree */
+} SIM_TEMP;
+
+typedef struct sim_memspace
+{
+    MEMSPACE_DEV_S dev;
+    UINT32      reg[256];
+} SIM_MEMSPACE;
+
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t simTimerCond = PTHREAD_COND_INITIALIZER;
+
+static SAC_DEV_HEADER * simDevHead;
+static SAC_DEV_HEADER ** simDevTail = &simDevHead;
+static SAC_DEV_HEADER * simFd[SIM_FD_MAX];
+static SIM_STATUS * simStatus[4];
+static SIM_ION * simIon;
+
+static UINT32 simFpgaErr;
+static UINT32 simFpgaSend;
+static UINT32 simFpgaRecv;
+
+static SIM_BUS simBus[SIM_BUS_CNT] =
+{
+    { "hsb" }, { "hcb" }, { "ion" }, { "eth" }, { "manage" }, { "sv" }, { "debug" }
+};
+
+/* xorshift64*, one stream per bus so a seed replays the same errors */
+static double sim_uniform(SIM_BUS * pBus)
+{
+    UINT64 x = pBus->rand;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    pBus->rand = x;
+    x *= 0x2545F4914F6CDD1DULL;
+
+    /* (0, 1] */
+    return ((x >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/* Trials passing before the next event of probability p */
+static UINT64 sim_geometric(SIM_BUS * pBus, double p)
+{
+    double k;
+
+    if (p <= 0)
+        return ~0ULL;
+    if (p >= 1)
+        return 0;
+
+    k = log(sim_uniform(pBus)) / log1p(-p);
+    return (k >= 1.8e19) ? ~0ULL : (UINT64)k;
+}
+
+/* Called with simLock held, may flip bits in data */
+static int sim_bus_impair(SIM_BUS * pBus, UINT8 * data, UINT32 len)
+{
+    UINT64 bits = (UINT64)len * 8;
+    UINT64 pos, skip;
+    int ret = SIM_PASS;
+
+    pBus->sent++;
+
+    if (pBus->lossSkip == 0)
+    {
+        pBus->lossSkip = sim_geometric(pBus, pBus->loss);
+        pBus->lost++;
+        return SIM_LOST;
+    }
+    if (pBus->lossSkip != ~0ULL)
+        pBus->lossSkip--;
+
+    if (pBus->bitSkip == ~0ULL)
+        return SIM_PASS;
+
+    pos = pBus->bitSkip;
+    while (pos < bits)
+    {
+        data[pos >> 3] ^= 0x80 >> (pos & 7);
+        ret = SIM_CORRUPT;
+        skip = sim_geometric(pBus, pBus->ber);
+        pos = (skip >= ~0ULL - pos) ? ~0ULL : pos + 1 + skip;
+    }
+    pBus->bitSkip = (pos == ~0ULL) ? ~0ULL : pos - bits;
+
+    if (ret == SIM_CORRUPT)
+        pBus->corrupted++;
+
+    return ret;
+}
+
+int sim_bus_set(const char * name, double loss, double ber, UINT32 rate)
+{
+    int i;
+
+    for (i = 0; i < SIM_BUS_CNT; i++)
+    {
+        if (strcmp(simBus[i].name, name))
+            continue;
+
+        pthread_mutex_lock(&simLock);
+        simBus[i].loss = loss;
+        simBus[i].ber = ber;
+        simBus[i].lossSkip = sim_geometric(&simBus[i], loss);
+        simBus[i].bitSkip = sim_geometric(&simBus[i], ber);
+        simBus[i].rate = rate;
+        pthread_mutex_unlock(&simLock);
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+static SIM_FRAME * sim_frame_new(const UINT8 * data, UINT32 len)
+{
+    SIM_FRAME * pFrame;
+
+    pFrame = malloc(sizeof(*pFrame) + len);
+    assert(pFrame != NULL);
+    memset(pFrame, 0, sizeof(*pFrame));
+    pFrame->len = len;
+    if (data)
+        memcpy(pFrame->data, data, len);
+
+    return pFrame;
+}
+
+/* Called with simLock held */
+static void sim_enqueue(SIM_QUEUE * pQueue, SIM_BUS * pBus, SIM_FRAME * pFrame)
+{
+    if (pQueue->count >= SIM_QUEUE_MAX)
+    {
+        pBus->overflow++;
+        free(pFrame);
+        return;
+    }
+
+    pFrame->next = NULL;
+    if (pQueue->tail)
+        pQueue->tail->next = pFrame;
+    else
+        pQueue->head = pFrame;
+    pQueue->tail = pFrame;
+    pQueue->count++;
+    pBus->delivered++;
+}
+
+/* Called with simLock held */
+static SIM_FRAME * sim_dequeue(SIM_QUEUE * pQueue)
+{
+    SIM_FRAME * pFrame = pQueue->head;
+
+    if (pFrame)
+    {
+        pQueue->head = pFrame->next;
+        if (pQueue->head == NULL)
+            pQueue->tail = NULL;
+        pQueue->count--;
+    }
+
+    return pFrame;
+}
+
+static void * sim_dev_add(UINT16 type, UINT32 size, BOOL exclusive)
+{
+    SAC_DEV_HEADER * pHdr;
+
+    pHdr = calloc(1, size);
+    assert(pHdr != NULL);
+    pHdr->type = type;
+    pHdr->exclusive = exclusive;
+
+    *simDevTail = pHdr;
+    simDevTail = &pHdr->next;
+
+    return pHdr;
+}
+
+static void * sim_fd_get(INT32 fd, UINT16 type)
+{
+    SAC_DEV_HEADER * pHdr;
+
+    if ((fd <= 0) || (fd >= SIM_FD_MAX))
+        return NULL;
+
+    pthread_mutex_lock(&simLock);
+    pHdr = simFd[fd];
+    pthread_mutex_unlock(&simLock);
+
+    if ((pHdr == NULL) || (pHdr->type != type))
+        return NULL;
+
+    return pHdr;
+}
+
+void * DescriptionGetByType(UINT16 type, void * pPrev)
+{
+    SAC_DEV_HEADER * pHdr;
+
+    pHdr = pPrev ? ((SAC_DEV_HEADER *)pPrev)->next : simDevHead;
+    while (pHdr && (pHdr->type != type))
+        pHdr = pHdr->next;
+
+    return pHdr;
+}
+
+INT32 DeviceRequest(void * pDev)
+{
+    SAC_DEV_HEADER * pHdr = pDev;
+    INT32 fd;
+
+    if (pHdr == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    if (pHdr->exclusive && pHdr->users)
+    {
+        pthread_mutex_unlock(&simLock);
+        return -EBUSY;
+    }
+    for (fd = 1; fd < SIM_FD_MAX; fd++)
+    {
+        if (simFd[fd] == NULL)
+        {
+            simFd[fd] = pHdr;
+            pHdr->users++;
+            pthread_mutex_unlock(&simLock);
+            return fd;
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return -EMFILE;
+}
+
+INT32 DeviceRelease(INT32 fd)
+{
+    if ((fd <= 0) || (fd >= SIM_FD_MAX))
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    if (simFd[fd] == NULL)
+    {
+        pthread_mutex_unlock(&simLock);
+        return -EINVAL;
+    }
+    simFd[fd]->users--;
+    simFd[fd] = NULL;
+    pthread_mutex_unlock(&simLock);
+
+    return 0;
+}
+
+/* BSP environment, only the board name is asked for */
+char * get_env(char * name)
+{
+    if (strcmp(name, "board") == 0)
+        return (char *)simBoard;
+
+    return "";
+}
+
+UINT32 sim_fpga_reg_read(UINT32 addr)
+{
+    UINT32 val = 0;
+
+    pthread_mutex_lock(&simLock);
+    switch (addr)
+    {
+    case SIM_HSB_REG_ERR:
+        val = simFpgaErr;
+        break;
+    case SIM_HSB_REG_RECV_CNT:
+        val = simFpgaRecv;
+        break;
+    case SIM_HSB_REG_SEND_CNT:
+        val = simFpgaSend;
+        break;
+    default:
+        break;
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return val;
+}
+
+void sim_fpga_reg_write(UINT32 addr, UINT32 val)
+{
+    pthread_mutex_lock(&simLock);
+    if (addr == SIM_HSB_REG_ERR)
+        simFpgaErr &= ~val;
+    pthread_mutex_unlock(&simLock);
+}
+
+/*
+ * Ethernet
+ */
+
+/* Each SIM_ETH send function is called with simLock held */
+static void sim_eth_loopback(SIM_ETH * pEth, const UINT8 * pkt, UINT32 len)
+{
+    SIM_FRAME * pFrame = sim_frame_new(pkt, len);
+
+    if (sim_bus_impair(pEth->pBus, pFrame->data, len) == SIM_LOST)
+        free(pFrame);
+    else
+        sim_enqueue(&pEth->rxQueue, pEth->pBus, pFrame);
+}
+
+/* Our own frame comes back, then one copy from each simulated node */
+static void sim_eth_manage(SIM_ETH * pEth, const UINT8 * pkt, UINT32 len)
+{
+    SIM_FRAME * pFrame;
+    UINT32 n;
+
+    sim_eth_loopback(pEth, pkt, len);
+
+    if (len < 12)
+        return;
+
+    for (n = 1; n <= simManageNodes; n++)
+    {
+        pFrame = sim_frame_new(pkt, len);
+        pFrame->data[11] = pEth->mac[5] + 0x10 * n;
+        if (sim_bus_impair(pEth->pBus, pFrame->data, len) == SIM_LOST)
+            free(pFrame);
+        else
+            sim_enqueue(&pEth->rxQueue, pEth->pBus, pFrame);
+    }
+}
+
+/* Frames leave the board and nothing comes back */
+static void sim_eth_sink(SIM_ETH * pEth, const UINT8 * pkt, UINT32 len)
+{
+    pEth->pBus->sent++;
+    pEth->pBus->delivered++;
+}
+
+/*
+ * The FPGA turns a send header into a receive header. Configuration packets
+ * stop at the FPGA, everything else is echoed by every simulated node named
+ * in DST.
+ */
+static void sim_eth_hsb(SIM_ETH * pEth, const UINT8 * pkt, UINT32 len)
+{
+    SIM_FRAME * pFrame;
+    UINT32 word, dst, dlc, n;
+
+    if (len < 12 + 4 + 1)
+        return;
+
+    simFpgaSend++;
+
+    word = ((UINT32)pkt[12] << 24) | ((UINT32)pkt[13] << 16) |
+            ((UINT32)pkt[14] << 8) | pkt[15];
+    dlc = word & 0x7FF;
+    dst = (word >> 11) & 0xFFFF;
+    if (16 + dlc > len)
+        dlc = len - 16;
+
+    if (pkt[16] == 0x02)
+        return;
+
+    for (n = 1; (n <= simHsbNodes) && (n < 16); n++)
+    {
+        if ((dst & (1 << n)) == 0)
+            continue;
+
+        pFrame = sim_frame_new(pkt, 16 + dlc);
+        word = (n << 11) | dlc;
+        pFrame->data[12] = word >> 24;
+        pFrame->data[13] = word >> 16;
+        pFrame->data[14] = word >> 8;
+        pFrame->data[15] = word;
+
+        switch (sim_bus_impair(pEth->pBus, pFrame->data, pFrame->len))
+        {
+        case SIM_CORRUPT:
+            /* cksum error on the line of this node */
+            simFpgaErr |= 0x10 << (n & 3);
+            /* fall through */
+        case SIM_LOST:
+            free(pFrame);
+            break;
+        default:
+            simFpgaRecv++;
+            sim_enqueue(&pEth->rxQueue, pEth->pBus, pFrame);
+            break;
+        }
+    }
+}
+
+/*
+ * SV frames arrive at simSvRate once the hook is enabled, generated when
+ * polled. smpCnt is at offset 22, the payload counts up from it.
+ */
+static void sim_eth_sv_gen(SIM_ETH * pEth)
+{
+    static const UINT8 svHdr[22] =
+    {
+        0x01, 0x0C, 0xCD, 0x04, 0x00, 0x01,     /* DST */
+        0x00, 0x0C, 0xCD, 0x00, 0x00, 0x01,     /* SRC */
+        0x88, 0xBA,                             /* SV */
+        0x40, 0x00,                             /* APPID */
+        0x00, 0x72,                             /* LEN */
+        0x00, 0x00, 0x00, 0x00                  /* Reserved */
+    };
+    SIM_FRAME * pFrame;
+    UINT64 due;
+    UINT32 i;
+
+    if (!pEth->genOn || !pEth->hookOn || (simSvRate == 0))
+        return;
+
+    due = (sim_nsec() - pEth->genStart) * simSvRate / 1000000000ULL;
+    if (due - pEth->genCount > SIM_QUEUE_MAX)
+    {
+        pEth->pBus->overflow += due - pEth->genCount - SIM_QUEUE_MAX;
+        pEth->genCount = due - SIM_QUEUE_MAX;
+    }
+
+    while (pEth->genCount < due)
+    {
+        pFrame = sim_frame_new(svHdr, 14 + 0x72);
+        for (i = 22; i < pFrame->len; i++)
+            pFrame->data[i] = pEth->genCount + i - 22;
+        pFrame->data[22] = pEth->genCount >> 8;
+        pFrame->data[23] = pEth->genCount;
+        pEth->genCount++;
+
+        if (sim_bus_impair(pEth->pBus, pFrame->data, pFrame->len) == SIM_LOST)
+            free(pFrame);
+        else
+            sim_enqueue(&pEth->rxQueue, pEth->pBus, pFrame);
+    }
+}
+
+static SIM_ETH * sim_eth_add(const char * name, UINT32 bus,
+        void (*send)(SIM_ETH *, const UINT8 *, UINT32))
+{
+    static UINT8 idx = 0;
+    SIM_ETH * pEth;
+
+    pEth = sim_dev_add(SAC_DEVICE_TYPE_ETHERNET, sizeof(*pEth), FALSE);
+    snprintf(pEth->dev.name, sizeof(pEth->dev.name), "%s", name);
+    pEth->pBus = &simBus[bus];
+    pEth->send = send;
+    pEth->mac[0] = 0x00;
+    pEth->mac[1] = 0xA0;
+    pEth->mac[2] = 0x1E;
+    pEth->mac[3] = simAddr;
+    pEth->mac[4] = idx++;
+    pEth->mac[5] = 0x01;
+
+    return pEth;
+}
+
+INT32 EthernetIPSet(INT32 fd, char * ip)
+{
+    return sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET) ? 0 : -EINVAL;
+}
+
+INT32 EthernetMACGet(INT32 fd, char * mac)
+{
+    SIM_ETH * pEth = sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET);
+
+    if (pEth == NULL)
+        return -EINVAL;
+
+    sprintf(mac, "%x.%x.%x.%x.%x.%x", pEth->mac[0], pEth->mac[1],
+            pEth->mac[2], pEth->mac[3], pEth->mac[4], pEth->mac[5]);
+    return 0;
+}
+
+/*
+ * A bus with a line rate queues frames in a SIM_TX_FIFO bytes transmit
+ * FIFO, a send is refused while the FIFO is full. Frames are still
+ * delivered at once.
+ */
+static BOOL sim_bus_fifo(SIM_BUS * pBus, UINT32 len)
+{
+    UINT64 now;
+
+    if (pBus->rate == 0)
+        return TRUE;
+
+    now = sim_nsec();
+    if (pBus->busyUntil < now)
+        pBus->busyUntil = now;
+    if (pBus->busyUntil - now > SIM_TX_FIFO * 8ULL * 1000000000ULL / pBus->rate)
+    {
+        pBus->busy++;
+        return FALSE;
+    }
+    pBus->busyUntil += len * 8ULL * 1000000000ULL / pBus->rate;
+    return TRUE;
+}
+
+INT32 EthernetSendPkt(INT32 fd, UINT8 * pkt, UINT32 len)
+{
+    SIM_ETH * pEth = sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET);
+
+    if ((pEth == NULL) || (pkt == NULL) || (len == 0) || (len > SIM_ETH_LEN_MAX))
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    if (!sim_bus_fifo(pEth->pBus, len))
+    {
+        pthread_mutex_unlock(&simLock);
+        return -EAGAIN;
+    }
+    pEth->send(pEth, pkt, len);
+    pthread_mutex_unlock(&simLock);
+
+    return 0;
+}
+
+INT32 EthernetRecvHook(INT32 fd, ETHERNET_RECV_HOOK hook)
+{
+    SIM_ETH * pEth = sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET);
+
+    if (pEth == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    pEth->hook = hook;
+    pthread_mutex_unlock(&simLock);
+    return 0;
+}
+
+INT32 EthernetHookEnable(INT32 fd)
+{
+    SIM_ETH * pEth = sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET);
+
+    if (pEth == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    pEth->hookOn = TRUE;
+    if (pEth->gen && !pEth->genOn)
+    {
+        pEth->genOn = TRUE;
+        pEth->genStart = sim_nsec();
+        pEth->genCount = 0;
+    }
+    pthread_mutex_unlock(&simLock);
+    return 0;
+}
+
+INT32 EthernetHookDisable(INT32 fd)
+{
+    SIM_ETH * pEth = sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET);
+
+    if (pEth == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    pEth->hookOn = FALSE;
+    pthread_mutex_unlock(&simLock);
+    return 0;
+}
+
+INT32 EthernetPktDrop(INT32 fd, UINT32 count)
+{
+    SIM_ETH * pEth = sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET);
+    SIM_FRAME * pFrame;
+    INT32 dropped = 0;
+
+    if (pEth == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    while ((dropped < count) && (pFrame = sim_dequeue(&pEth->rxQueue)) != NULL)
+    {
+        free(pFrame);
+        dropped++;
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return dropped;
+}
+
+/* -EAGAIN while frames are left after *pLimit of them, 0 once drained */
+INT32 EthernetRecvPoll(INT32 fd, UINT32 * pLimit)
+{
+    SIM_ETH * pEth = sim_fd_get(fd, SAC_DEVICE_TYPE_ETHERNET);
+    UINT32 limit = (pLimit && *pLimit) ? *pLimit : SIM_POLL_BATCH;
+    ETHERNET_RECV_HOOK hook;
+    SIM_FRAME * pFrame;
+    UINT32 done;
+    BOOL more;
+
+    if (pEth == NULL)
+        return -EINVAL;
+
+    for (done = 0; done < limit; done++)
+    {
+        pthread_mutex_lock(&simLock);
+        if (pEth->gen)
+            pEth->gen(pEth);
+        pFrame = sim_dequeue(&pEth->rxQueue);
+        hook = pEth->hookOn ? pEth->hook : NULL;
+        pthread_mutex_unlock(&simLock);
+
+        if (pFrame == NULL)
+            return 0;
+
+        if (hook)
+            hook(&pEth->dev, pFrame->data, pFrame->len);
+        free(pFrame);
+    }
+
+    pthread_mutex_lock(&simLock);
+    more = (pEth->rxQueue.count != 0);
+    pthread_mutex_unlock(&simLock);
+
+    return more ? -EAGAIN : 0;
+}
+
+/*
+ * Status, indicators and other board devices
+ */
+INT32 StatusAssert(INT32 fd)
+{
+    SIM_STATUS * pStatus = sim_fd_get(fd, SAC_DEVICE_TYPE_STATUS);
+
+    if (pStatus == NULL)
+        return -EINVAL;
+
+    pStatus->state = SAC_STATUS_ASSERT;
+    return 0;
+}
+
+INT32 StatusDessert(INT32 fd)
+{
+    SIM_STATUS * pStatus = sim_fd_get(fd, SAC_DEVICE_TYPE_STATUS);
+
+    if (pStatus == NULL)
+        return -EINVAL;
+
+    pStatus->state = SAC_STATUS_DESSERT;
+    return 0;
+}
+
+/* The _RET inputs read back the output before them */
+INT32 StatusGet(INT32 fd)
+{
+    SIM_STATUS * pStatus = sim_fd_get(fd, SAC_DEVICE_TYPE_STATUS);
+
+    if (pStatus == NULL)
+        return -EINVAL;
+
+    if (pStatus->dev.type & 1)
+        pStatus = simStatus[pStatus->dev.type - 1];
+
+    return pStatus->state;
+}
+
+INT32 LightOn(INT32 fd)
+{
+    SIM_LED * pLed = sim_fd_get(fd, SAC_DEVICE_TYPE_INDICATOR);
+
+    if (pLed == NULL)
+        return -EINVAL;
+
+    pLed->on = TRUE;
+    return 0;
+}
+
+INT32 LightOff(INT32 fd)
+{
+    SIM_LED * pLed = sim_fd_get(fd, SAC_DEVICE_TYPE_INDICATOR);
+
+    if (pLed == NULL)
+        return -EINVAL;
+
+    pLed->on = FALSE;
+    return 0;
+}
+
+INT32 TimeGet(INT32 fd, INT32 * pTime)
+{
+    if (sim_fd_get(fd, SAC_DEVICE_TYPE_RTC) == NULL)
+        return -EINVAL;
+
+    *pTime = time(NULL);
+    return 0;
+}
+
+INT32 IRIGBStatus(INT32 fd)
+{
+    return sim_fd_get(fd, SAC_DEVICE_TYPE_IRIGB) ? 0 : -EINVAL;
+}
+
+INT32 DateTimeStatus(INT32 fd)
+{
+    return sim_fd_get(fd, SAC_DEVICE_TYPE_DATETIME) ? 0 : -EINVAL;
+}
+
+INT32 TemperatureGet(INT32 fd, INT32 * pTemp, UINT32 * pRatio)
+{
+    SIM_TEMP * pTemp_ = sim_fd_get(fd, SAC_DEVICE_TYPE_TEMP_SENSOR);
+
+    if (pTemp_ == NULL)
+        return -EINVAL;
+
+    *pTemp = pTemp_->temp;
+    *pRatio = 10;
+    return 0;
+}
+
+/* Half a percent above nominal */
+INT32 VoltageGet(INT32 fd, UINT32 * pVol)
+{
+    VOLSNR_DEV_S * pDev = sim_fd_get(fd, SAC_DEVICE_TYPE_VOL_SENSOR);
+
+    if (pDev == NULL)
+        return -EINVAL;
+
+    *pVol = pDev->normal_voltage + pDev->normal_voltage / 200;
+    return 0;
+}
+
+INT32 RHGet(INT32 fd, UINT32 * pRH, UINT32 * pRatio)
+{
+    if (sim_fd_get(fd, SAC_DEVICE_TYPE_RH_SENSOR) == NULL)
+        return -EINVAL;
+
+    *pRH = 45250;
+    *pRatio = 1000;
+    return 0;
+}
+
+INT32 MSRegWrite(INT32 fd, UINT32 addr, UINT32 val)
+{
+    SIM_MEMSPACE * pMs = sim_fd_get(fd, SAC_DEVICE_TYPE_MEMSPACE);
+
+    if (pMs == NULL)
+        return -EINVAL;
+
+    pMs->reg[addr & 0xFF] = val;
+    return 0;
+}
+
+INT32 MSRegRead(INT32 fd, UINT32 addr)
+{
+    SIM_MEMSPACE * pMs = sim_fd_get(fd, SAC_DEVICE_TYPE_MEMSPACE);
+
+    if (pMs == NULL)
+        return -EINVAL;
+
+    return pMs->reg[addr & 0xFF];
+}
+
+INT32 UARTConfig(INT32 fd, UINT32 baud, UINT32 opt)
+{
+    return sim_fd_get(fd, SAC_DEVICE_TYPE_UART) ? 0 : -EINVAL;
+}
+
+INT32 UARTSend(INT32 fd, UINT8 * buf, UINT32 len)
+{
+    return sim_fd_get(fd, SAC_DEVICE_TYPE_UART) ? len : -EINVAL;
+}
+
+/*
+ * Timers, one thread each, started on the first TimerEnable(). A timer
+ * falling more than 100 periods behind skips the missed ticks like lost
+ * interrupts would.
+ */
+static void * sim_timer_thread(void * arg)
+{
+    SIM_TIMER * pTimer = arg;
+    UINT64 period = 0, next = 0, now;
+    UINT32 gen = ~0U;
+    VOIDFUNCPTR isr;
+    _Vx_usr_arg_t isrArg;
+
+    FOREVER
+    {
+        pthread_mutex_lock(&simLock);
+        while (!pTimer->enabled || !pTimer->freq || !pTimer->isr)
+            pthread_cond_wait(&simTimerCond, &simLock);
+        if (gen != pTimer->gen)
+        {
+            gen = pTimer->gen;
+            period = 1000000000ULL / pTimer->freq;
+            next = sim_nsec();
+        }
+        pthread_mutex_unlock(&simLock);
+
+        next += period;
+        now = sim_nsec();
+        if (now > next + 100 * period)
+            next = now;
+        sim_sleep_until(next);
+
+        pthread_mutex_lock(&simLock);
+        isr = (pTimer->enabled && (gen == pTimer->gen)) ? pTimer->isr : NULL;
+        isrArg = pTimer->arg;
+        pthread_mutex_unlock(&simLock);
+
+        if (isr)
+            ((void (*)(_Vx_usr_arg_t))isr)(isrArg);
+    }
+
+    return NULL;
+}
+
+static INT32 sim_timer_set(INT32 fd, int enable, UINT32 freq, VOIDFUNCPTR isr,
+        _Vx_usr_arg_t arg)
+{
+    SIM_TIMER * pTimer = sim_fd_get(fd, SAC_DEVICE_TYPE_TIMER);
+
+    if (pTimer == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    if (enable >= 0)
+        pTimer->enabled = enable;
+    if (freq)
+        pTimer->freq = freq;
+    if (isr)
+    {
+        pTimer->isr = isr;
+        pTimer->arg = arg;
+    }
+    pTimer->gen++;
+    if (pTimer->enabled && !pTimer->running)
+    {
+        assert(pthread_create(&pTimer->thread, NULL, sim_timer_thread, pTimer) == 0);
+        pthread_detach(pTimer->thread);
+        pTimer->running = TRUE;
+    }
+    pthread_cond_broadcast(&simTimerCond);
+    pthread_mutex_unlock(&simLock);
+
+    return 0;
+}
+
+INT32 TimerDisable(INT32 fd)
+{
+    return sim_timer_set(fd, 0, 0, NULL, 0);
+}
+
+INT32 TimerEnable(INT32 fd)
+{
+    return sim_timer_set(fd, 1, 0, NULL, 0);
+}
+
+INT32 TimerFreqSet(INT32 fd, UINT32 freq)
+{
+    if (freq == 0)
+        return -EINVAL;
+
+    return sim_timer_set(fd, -1, freq, NULL, 0);
+}
+
+INT32 TimerISRSet(INT32 fd, VOIDFUNCPTR isr, _Vx_usr_arg_t arg)
+{
+    if (isr == NULL)
+        return -EINVAL;
+
+    return sim_timer_set(fd, -1, 0, isr, arg);
+}
+
+/*
+ * CAN-HCB, a packet naming our own address in DST loops back, the nodes in
+ * simHcbNodes named in DST echo it back from their own address
+ */
+INT32 CANHCBStatusGet(INT32 fd)
+{
+    SIM_HCB * pHcb = sim_fd_get(fd, SAC_DEVICE_TYPE_CANHCB);
+    INT32 status;
+
+    if (pHcb == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    status = pHcb->status;
+    pHcb->status = 0;
+    pthread_mutex_unlock(&simLock);
+
+    return status;
+}
+
+INT32 CANHCBHookRegister(INT32 fd, CANHCB_RECV_HOOK hook)
+{
+    SIM_HCB * pHcb = sim_fd_get(fd, SAC_DEVICE_TYPE_CANHCB);
+
+    if (pHcb == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    pHcb->hook = hook;
+    pthread_mutex_unlock(&simLock);
+    return 0;
+}
+
+INT32 CANHCBPktSend(INT32 fd, CANHCB_PKT_S * pPkt)
+{
+    SIM_HCB * pHcb = sim_fd_get(fd, SAC_DEVICE_TYPE_CANHCB);
+    SIM_BUS * pBus = &simBus[SIM_BUS_HCB];
+    SIM_FRAME * pFrame;
+    UINT32 node, nodes;
+
+    if ((pHcb == NULL) || (pPkt == NULL) || (pPkt->pkt_buf == NULL) ||
+            (pPkt->DLC > SIM_HCB_DLC_MAX))
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    nodes = pPkt->DST & ((1 << simAddr) | simHcbNodes);
+    for (node = 0; nodes; node++)
+    {
+        if ((nodes & (1 << node)) == 0)
+            continue;
+        nodes &= ~(1 << node);
+
+        pFrame = sim_frame_new(pPkt->pkt_buf, pPkt->DLC);
+        pFrame->src = node;
+        pFrame->dst = pPkt->DST;
+        switch (sim_bus_impair(pBus, pFrame->data, pFrame->len))
+        {
+        case SIM_CORRUPT:
+            if (simHcbCrcLeak)
+            {
+                sim_enqueue(&pHcb->rxQueue, pBus, pFrame);
+                break;
+            }
+            pHcb->status |= SAC_CANHCB_STATUS_LEN_CRC_ERR;
+            /* fall through */
+        case SIM_LOST:
+            free(pFrame);
+            break;
+        default:
+            sim_enqueue(&pHcb->rxQueue, pBus, pFrame);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return 0;
+}
+
+INT32 CANHCBPktPoll(INT32 fd)
+{
+    SIM_HCB * pHcb = sim_fd_get(fd, SAC_DEVICE_TYPE_CANHCB);
+    CANHCB_RECV_HOOK hook;
+    CANHCB_PKT_S * pPkt;
+    SIM_FRAME * pFrame;
+
+    if (pHcb == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    pFrame = sim_dequeue(&pHcb->rxQueue);
+    hook = pHcb->hook;
+    pthread_mutex_unlock(&simLock);
+
+    if (pFrame == NULL)
+        return -EAGAIN;
+
+    pPkt = hook ? hook(pFrame->src) : NULL;
+    if (pPkt)
+    {
+        pPkt->SRC = pFrame->src;
+        pPkt->DST = pFrame->dst;
+        pPkt->DLC = pFrame->len;
+        memcpy(pPkt->pkt_buf, pFrame->data, pFrame->len);
+    }
+    free(pFrame);
+
+    return 0;
+}
+
+/*
+ * ION, the IOMs in simIoms answer the temperature (0x63) and statistics
+ * (0x49) requests. Once started by the 0x41 broadcast each sends a heartbeat
+ * (0x09) and a DI report (0x10) every second, and a DI report on change.
+ * A DO command (0x5A) drives the first DI bytes of the same IOM, like a
+ * DO to DI loopback fixture. sim_iom_down() powers an IOM off for a while,
+ * it neither reports nor answers until it is back.
+ */
+
+/* Called with simLock held */
+static BOOL sim_ion_up(const SIM_ION * pIon, UINT8 iom, UINT64 now)
+{
+    return (now < pIon->downFrom[iom]) || (now >= pIon->downUntil[iom]);
+}
+
+/* Called with simLock held */
+static void sim_ion_reply(SIM_ION * pIon, UINT8 src, const UINT8 * data, UINT32 len)
+{
+    SIM_BUS * pBus = &simBus[SIM_BUS_ION];
+    SIM_FRAME * pFrame;
+
+    pFrame = sim_frame_new(data, len);
+    pFrame->src = src;
+    pFrame->dst = simAddr;
+
+    if (sim_bus_impair(pBus, pFrame->data, pFrame->len) == SIM_PASS)
+        sim_enqueue(&pIon->rxQueue, pBus, pFrame);
+    else
+        free(pFrame);
+}
+
+/* Called with simLock held */
+static void sim_ion_di_report(SIM_ION * pIon, UINT8 iom)
+{
+    UINT8 buf[14] = {0};
+
+    buf[0] = 12;                    /* LEN */
+    buf[1] = 0x10;                  /* TYPE */
+    buf[2] = pIon->diSeq++;         /* SEQ */
+    memcpy(buf + 5, pIon->DI[iom], 8);
+    sim_ion_reply(pIon, iom, buf, sizeof(buf));
+}
+
+/* Called with simLock held */
+static void sim_ion_gen(SIM_ION * pIon)
+{
+    UINT8 hb[4] = { 2, 0x09, 0x01, 0x00 };
+    UINT64 now = sim_nsec();
+    UINT8 iom;
+
+    for (iom = 0; iom < SIM_IOM_NUM; iom++)
+    {
+        if (((pIon->started & pIon->diPending) & (1U << iom)) && sim_ion_up(pIon, iom, now))
+            sim_ion_di_report(pIon, iom);
+    }
+    pIon->diPending = 0;
+
+    if (!pIon->started || (now < pIon->nextReport))
+        return;
+    pIon->nextReport = now + SIM_ION_REPORT_NS;
+
+    for (iom = 0; iom < SIM_IOM_NUM; iom++)
+    {
+        if (((pIon->started & (1U << iom)) == 0) || !sim_ion_up(pIon, iom, now))
+            continue;
+        sim_ion_reply(pIon, iom, hb, sizeof(hb));
+        sim_ion_di_report(pIon, iom);
+    }
+}
+
+/* Power IOM iom off after seconds after, for seconds seconds */
+int sim_iom_down(UINT32 iom, UINT32 after, UINT32 seconds)
+{
+    if ((simIon == NULL) || (iom >= SIM_IOM_NUM))
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    simIon->downFrom[iom] = sim_nsec() + after * 1000000000ULL;
+    simIon->downUntil[iom] = simIon->downFrom[iom] + seconds * 1000000000ULL;
+    pthread_mutex_unlock(&simLock);
+
+    return 0;
+}
+
+int sim_di_toggle(UINT32 iom, UINT32 di)
+{
+    if ((simIon == NULL) || (iom >= SIM_IOM_NUM) || (di == 0) || (di > 64))
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    simIon->DI[iom][(di - 1) / 8] ^= 1 << ((di - 1) % 8);
+    simIon->diPending |= 1U << iom;
+    pthread_mutex_unlock(&simLock);
+
+    return 0;
+}
+
+INT32 IONHookRegister(INT32 fd, ION_RECV_HOOK hook)
+{
+    SIM_ION * pIon = sim_fd_get(fd, SAC_DEVICE_TYPE_ION);
+
+    if (pIon == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    pIon->hook = hook;
+    pthread_mutex_unlock(&simLock);
+    return 0;
+}
+
+INT32 IONPktSend(INT32 fd, ION_PKT_S * pPkt)
+{
+    SIM_ION * pIon = sim_fd_get(fd, SAC_DEVICE_TYPE_ION);
+    UINT8 buf[62] = {0};
+    UINT8 iom;
+    UINT32 i;
+
+    if ((pIon == NULL) || (pPkt == NULL) || (pPkt->pkt_buf == NULL) ||
+            (pPkt->DLC < 2) || (pPkt->DLC > SIM_ION_DLC_MAX))
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    iom = pPkt->DST;
+
+    if ((iom == 0x3E) && (pPkt->pkt_buf[1] == 0x41))
+    {
+        pIon->started = simIoms;
+        pIon->nextReport = 0;
+    }
+    else if ((iom < SIM_IOM_NUM) && (simIoms & (1U << iom)) &&
+            sim_ion_up(pIon, iom, sim_nsec()))
+    {
+        switch (pPkt->pkt_buf[1])
+        {
+        case 0x63:
+            buf[0] = 3;
+            buf[1] = 0x16;
+            buf[3] = 30 + iom;          /* Temperature */
+            sim_ion_reply(pIon, iom, buf, 5);
+            break;
+        case 0x49:
+            buf[0] = 60;
+            buf[1] = 0x05;
+            buf[56] = iom;              /* Resets, little endian */
+            sim_ion_reply(pIon, iom, buf, 62);
+            break;
+        case 0x5A:
+            for (i = 0; (i < 3) && (4 + 2 * i < pPkt->DLC); i++)
+            {
+                UINT8 msk = pPkt->pkt_buf[3 + 2 * i], dout = pPkt->pkt_buf[4 + 2 * i];
+                UINT8 di = (pIon->DI[iom][i] & ~msk) | (dout & msk);
+
+                if (di != pIon->DI[iom][i])
+                    pIon->diPending |= 1U << iom;
+                pIon->DI[iom][i] = di;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return 0;
+}
+
+/* 0 for a packet handed to the hook, -EAGAIN if none is pending */
+INT32 IONPktPoll(INT32 fd)
+{
+    SIM_ION * pIon = sim_fd_get(fd, SAC_DEVICE_TYPE_ION);
+    ION_RECV_HOOK hook;
+    ION_PKT_S * pPkt;
+    SIM_FRAME * pFrame;
+
+    if (pIon == NULL)
+        return -EINVAL;
+
+    pthread_mutex_lock(&simLock);
+    sim_ion_gen(pIon);
+    pFrame = sim_dequeue(&pIon->rxQueue);
+    hook = pIon->hook;
+    pthread_mutex_unlock(&simLock);
+
+    if (pFrame == NULL)
+        return -EAGAIN;
+
+    pPkt = hook ? hook(pFrame->data[1]) : NULL;
+    if (pPkt)
+    {
+        pPkt->SRC = pFrame->src;
+        pPkt->DST = pFrame->dst;
+        pPkt->PRI = 0;
+        pPkt->RP = pFrame->rp;
+        pPkt->DLC = pFrame->len;
+        memcpy(pPkt->pkt_buf, pFrame->data, pFrame->len);
+    }
+    free(pFrame);
+
+    return 0;
+}
+
+/*
+ * Board
+ */
+static void sim_seed(void)
+{
+    UINT64 x = simSeed ? simSeed : 1;
+    int i;
+
+    for (i = 0; i < SIM_BUS_CNT; i++)
+    {
+        /* splitmix64, never leaves a zero xorshift state */
+        x += 0x9E3779B97F4A7C15ULL;
+        simBus[i].rand = x ^ (x >> 31);
+        if (simBus[i].rand == 0)
+            simBus[i].rand = 1;
+        simBus[i].lossSkip = sim_geometric(&simBus[i], simBus[i].loss);
+        simBus[i].bitSkip = sim_geometric(&simBus[i], simBus[i].ber);
+    }
+}
+
+/* Build the device table, simBoard and simAddr must be set before */
+void sim_init(void)
+{
+    static const UINT32 voltages[] = { 3300, 1800, 1000, 24000 };
+    BOOL cpu = (strncmp(simBoard, "NPS-CPU", strlen("NPS-CPU")) == 0);
+    FPGA_DEV_S * pFpga;
+    SIM_LED * pLed;
+    SIM_TEMP * pTemp;
+    VOLSNR_DEV_S * pVol;
+    UART_DEV_S * pUart;
+    SIM_MEMSPACE * pMs;
+    SIM_ETH * pEth;
+    char name[16];
+    int i;
+
+    sim_seed();
+
+    pFpga = sim_dev_add(SAC_DEVICE_TYPE_FPGA, sizeof(*pFpga), FALSE);
+    pFpga->addr = simAddr;
+
+    sim_eth_add("hsb", SIM_BUS_HSB, sim_eth_hsb);
+    sim_eth_add("manage", SIM_BUS_MANAGE, sim_eth_manage);
+    sim_eth_add("debug", SIM_BUS_DEBUG, sim_eth_sink);
+    if (cpu)
+    {
+        pEth = sim_eth_add("sv", SIM_BUS_SV, sim_eth_sink);
+        pEth->gen = sim_eth_sv_gen;
+    }
+    else
+    {
+        for (i = 1; i <= 4; i++)
+        {
+            sprintf(name, "MMS%d", i);
+            sim_eth_add(name, SIM_BUS_ETH, sim_eth_loopback);
+        }
+    }
+
+    for (i = 0; i < 4; i++)
+    {
+        simStatus[i] = sim_dev_add(SAC_DEVICE_TYPE_STATUS, sizeof(SIM_STATUS), FALSE);
+        simStatus[i]->dev.type = i;
+    }
+
+    for (i = 1; i <= 3; i++)
+    {
+        pLed = sim_dev_add(SAC_DEVICE_TYPE_INDICATOR, sizeof(*pLed), FALSE);
+        sprintf(pLed->dev.color, "LED%d", i);
+    }
+
+    for (i = 0; i < SIM_TIMER_CNT; i++)
+        sim_dev_add(SAC_DEVICE_TYPE_TIMER, sizeof(SIM_TIMER), TRUE);
+
+    sim_dev_add(SAC_DEVICE_TYPE_CANHCB, sizeof(SIM_HCB), FALSE);
+    if (cpu)
+        simIon = sim_dev_add(SAC_DEVICE_TYPE_ION, sizeof(SIM_ION), FALSE);
+
+    pTemp = sim_dev_add(SAC_DEVICE_TYPE_TEMP_SENSOR, sizeof(*pTemp), FALSE);
+    pTemp->dev.location = SACDEV_TMPSNR_LOC_PROCCESSOR;
+    pTemp->temp = 552;
+    pTemp = sim_dev_add(SAC_DEVICE_TYPE_TEMP_SENSOR, sizeof(*pTemp), FALSE);
+    pTemp->dev.location = SACDEV_TMPSNR_LOC_BOARD;
+    pTemp->temp = 418;
+
+    for (i = 0; i < sizeof(voltages) / sizeof(voltages[0]); i++)
+    {
+        pVol = sim_dev_add(SAC_DEVICE_TYPE_VOL_SENSOR, sizeof(*pVol), FALSE);
+        pVol->normal_voltage = voltages[i];
+    }
+
+    pUart = sim_dev_add(SAC_DEVICE_TYPE_UART, sizeof(*pUart), TRUE);
+    strcpy(pUart->name, "COM1");
+
+    pMs = sim_dev_add(SAC_DEVICE_TYPE_MEMSPACE, sizeof(*pMs), FALSE);
+    strcpy(pMs->dev.devName, "FRAM");
+
+    if (!cpu)
+    {
+        sim_dev_add(SAC_DEVICE_TYPE_RTC, sizeof(RTC_DEV_S), FALSE);
+        sim_dev_add(SAC_DEVICE_TYPE_RH_SENSOR, sizeof(RHSNR_DEV_S), FALSE);
+        sim_dev_add(SAC_DEVICE_TYPE_IRIGB, sizeof(SAC_DEV_HEADER), FALSE);
+    }
+    else
+        sim_dev_add(SAC_DEVICE_TYPE_DATETIME, sizeof(SAC_DEV_HEADER), FALSE);
+}
+
+void sim_info(void)
+{
+    int i;
+
+    pthread_mutex_lock(&simLock);
+    printf("\n%-8s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "BUS", "Sent",
+            "Delivered", "Lost", "Corrupted", "Overflow", "Busy", "Loss", "BER",
+            "Rate");
+    for (i = 0; i < SIM_BUS_CNT; i++)
+        printf("%-8s %10u %10u %10u %10u %10u %10u %10g %10g %10u\n", simBus[i].name,
+                simBus[i].sent, simBus[i].delivered, simBus[i].lost,
+                simBus[i].corrupted, simBus[i].overflow, simBus[i].busy,
+                simBus[i].loss, simBus[i].ber, simBus[i].rate);
+    printf("HSB FPGA : Send %u, Recv %u, Err 0x%X\n", simFpgaSend, simFpgaRecv,
+            simFpgaErr);
+    pthread_mutex_unlock(&simLock);
+}
@@ -0,0 +1,43 @@
+/*
+ * Host simulation control, shared by vxsim.c, sacsim.c and main.c
+ */
+#ifndef __HOST_SIM_H
+#define __HOST_SIM_H
+
+#include <vxWorks.h>
+
+/* vxsim.c */
+extern void sim_clock_init(void);
+extern UINT64 sim_nsec(void);
+extern void sim_sleep_until(UINT64 ns);
+
+/*
+ * sacsim.c
+ *
+ * simBoard     : board name returned by get_env("board")
+ * simAddr      : FPGA address of this node
+ * simSeed      : seed of the loss and bit error sampling
+ * simHsbNodes  : HSB nodes echoing every SFP packet, numbered from 1
+ * simManageNodes : extra nodes on the manage bus echoing our frames
+ * simIoms      : bitmask of the IOMs answering on ION
+ * simHcbCrcLeak : HCB frames hit by bit errors are delivered, not dropped
+ * simHcbNodes  : bitmask of the HCB addresses echoing the frames sent to them
+ * simSvRate    : SV frames per second received on the CPU board
+ */
+extern const char * simBoard;
+extern UINT8 simAddr;
+extern UINT32 simSeed;
+extern UINT32 simHsbNodes;
+extern UINT32 simManageNodes;
+extern UINT32 simIoms;
+extern UINT32 simHcbCrcLeak;
+extern UINT32 simHcbNodes;
+extern UINT32 simSvRate;
+
+extern void sim_init(void);
+extern int sim_bus_set(const char * name, double loss, double ber, UINT32 rate);
+extern void sim_info(void);
+extern int sim_di_toggle(UINT32 iom, UINT32 di);
+extern int sim_iom_down(UINT32 iom, UINT32 after, UINT32 seconds);
+
+#endif /* __HOST_SIM_H */
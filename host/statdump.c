@@ -0,0 +1,43 @@
+/*
+ * Decode a binary statistics log into the text report
+ *
+ *   statdump [-n count] file
+ *
+ * Files written by any board decode here, big endian targets included. The
+ * modules are linked for their STATLOG_CODEC only, none of them is started.
+ */
+#include "lib.h"
+
+#include <unistd.h>
+
+int main(int argc, char * argv[])
+{
+    UINT32 count = 0;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            printf("usage: %s [-n count] file\n"
+                   "  -n count      newest count frames only, default all\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        printf("usage: %s [-n count] file\n", argv[0]);
+        return 1;
+    }
+
+    ret = statlog_show(argv[optind], count);
+    if (ret)
+        printf("%s : decode failed %d\n", argv[optind], ret);
+    fflush(stdout);
+    return ret ? 1 : 0;
+}
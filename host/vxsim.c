@@ -0,0 +1,465 @@
+/*
+ * VxWorks kernel services for the host build
+ *
+ * Tasks are detached pthreads, priorities and options are ignored. The
+ * system clock runs at SIM_CLK_RATE ticks per second on CLOCK_MONOTONIC.
+ */
+#define _GNU_SOURCE
+#include <vxWorks.h>
+#include <semLib.h>
+#include <taskLib.h>
+#include <lstLib.h>
+#include <sysLib.h>
+#include <tickLib.h>
+#include <jobQueueLib.h>
+#include <arch/ppc/vxPpcLib.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sim.h"
+
+#define SIM_CLK_RATE    100
+#define SIM_LOG_FDS     8
+
+struct sim_semaphore
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             type;       /* 'B', 'C' or 'M' */
+    int             count;
+    pthread_t       owner;
+};
+
+struct sim_job_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    QJOB *          head;
+};
+
+typedef struct sim_task
+{
+    FUNCPTR         entry;
+    _Vx_usr_arg_t   arg[10];
+    char            name[32];
+} SIM_TASK;
+
+static struct timespec simEpoch;
+static pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+static int logFds[SIM_LOG_FDS];
+static int logFdCnt;
+
+void sim_clock_init(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &simEpoch);
+}
+
+UINT64 sim_nsec(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (UINT64)(t.tv_sec - simEpoch.tv_sec) * 1000000000ULL +
+            t.tv_nsec - simEpoch.tv_nsec;
+}
+
+/* Sleep until an absolute sim_nsec() time */
+void sim_sleep_until(UINT64 ns)
+{
+    struct timespec t;
+
+    ns += (UINT64)simEpoch.tv_sec * 1000000000ULL + simEpoch.tv_nsec;
+    t.tv_sec = ns / 1000000000ULL;
+    t.tv_nsec = ns % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR)
+        ;
+}
+
+int sysClkRateGet(void)
+{
+    return SIM_CLK_RATE;
+}
+
+ULONG tickGet(void)
+{
+    return sim_nsec() / (1000000000ULL / SIM_CLK_RATE);
+}
+
+/* The emulated time base counts nanoseconds */
+void vxTimeBaseGet(UINT32 * pTbu, UINT32 * pTbl)
+{
+    UINT64 ns = sim_nsec();
+
+    *pTbu = ns >> 32;
+    *pTbl = (UINT32)ns;
+}
+
+static void * sim_task_entry(void * arg)
+{
+    SIM_TASK * pTask = arg;
+    SIM_TASK task = *pTask;
+
+    free(pTask);
+    pthread_setname_np(pthread_self(), task.name);
+    ((int (*)(_Vx_usr_arg_t, _Vx_usr_arg_t, _Vx_usr_arg_t, _Vx_usr_arg_t,
+            _Vx_usr_arg_t, _Vx_usr_arg_t, _Vx_usr_arg_t, _Vx_usr_arg_t,
+            _Vx_usr_arg_t, _Vx_usr_arg_t))task.entry)(task.arg[0], task.arg[1],
+            task.arg[2], task.arg[3], task.arg[4], task.arg[5], task.arg[6],
+            task.arg[7], task.arg[8], task.arg[9]);
+    return NULL;
+}
+
+TASK_ID taskSpawn(char * name, int priority, int options, int stackSize,
+        FUNCPTR entryPt, _Vx_usr_arg_t arg1, _Vx_usr_arg_t arg2,
+        _Vx_usr_arg_t arg3, _Vx_usr_arg_t arg4, _Vx_usr_arg_t arg5,
+        _Vx_usr_arg_t arg6, _Vx_usr_arg_t arg7, _Vx_usr_arg_t arg8,
+        _Vx_usr_arg_t arg9, _Vx_usr_arg_t arg10)
+{
+    SIM_TASK * pTask;
+    pthread_attr_t attr;
+    pthread_t tid;
+
+    pTask = malloc(sizeof(*pTask));
+    if (pTask == NULL)
+        return TASK_ID_ERROR;
+
+    pTask->entry = entryPt;
+    pTask->arg[0] = arg1;
+    pTask->arg[1] = arg2;
+    pTask->arg[2] = arg3;
+    pTask->arg[3] = arg4;
+    pTask->arg[4] = arg5;
+    pTask->arg[5] = arg6;
+    pTask->arg[6] = arg7;
+    pTask->arg[7] = arg8;
+    pTask->arg[8] = arg9;
+    pTask->arg[9] = arg10;
+    /* Linux limits thread names to 15 characters */
+    snprintf(pTask->name, 16, "%s", name ? name : "tTask");
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &attr, sim_task_entry, pTask))
+    {
+        pthread_attr_destroy(&attr);
+        free(pTask);
+        return TASK_ID_ERROR;
+    }
+    pthread_attr_destroy(&attr);
+
+    return (TASK_ID)tid;
+}
+
+STATUS taskDelay(int ticks)
+{
+    if (ticks <= 0)
+    {
+        sched_yield();
+        return OK;
+    }
+
+    /* Wake on a tick edge like the kernel does */
+    sim_sleep_until((tickGet() + ticks) * (1000000000ULL / SIM_CLK_RATE));
+    return OK;
+}
+
+TASK_ID taskIdSelf(void)
+{
+    return (TASK_ID)pthread_self();
+}
+
+/* Threads are scheduled by the host, every task looks like an application task */
+STATUS taskPriorityGet(TASK_ID tid, int * pPriority)
+{
+    if (pPriority == NULL)
+        return ERROR;
+    *pPriority = 100;
+    return OK;
+}
+
+static SEM_ID sim_sem_create(int type, int count)
+{
+    SEM_ID semId;
+
+    semId = malloc(sizeof(*semId));
+    if (semId == NULL)
+        return NULL;
+
+    pthread_mutex_init(&semId->lock, NULL);
+    pthread_cond_init(&semId->cond, NULL);
+    semId->type = type;
+    semId->count = count;
+
+    return semId;
+}
+
+SEM_ID semBCreate(int options, SEM_B_STATE initialState)
+{
+    return sim_sem_create('B', initialState == SEM_FULL);
+}
+
+SEM_ID semCCreate(int options, int initialCount)
+{
+    return sim_sem_create('C', initialCount);
+}
+
+SEM_ID semMCreate(int options)
+{
+    return sim_sem_create('M', 0);
+}
+
+STATUS semTake(SEM_ID semId, int timeout)
+{
+    struct timespec t;
+    pthread_t self = pthread_self();
+    STATUS ret = OK;
+
+    if (semId == NULL)
+        return ERROR;
+
+    if (timeout > 0)
+    {
+        UINT64 ns;
+
+        clock_gettime(CLOCK_REALTIME, &t);
+        ns = (UINT64)t.tv_sec * 1000000000ULL + t.tv_nsec +
+                (UINT64)timeout * (1000000000ULL / SIM_CLK_RATE);
+        t.tv_sec = ns / 1000000000ULL;
+        t.tv_nsec = ns % 1000000000ULL;
+    }
+
+    pthread_mutex_lock(&semId->lock);
+
+    /* Mutexes are recursive for their owner */
+    if ((semId->type == 'M') && semId->count && pthread_equal(semId->owner, self))
+    {
+        semId->count++;
+        pthread_mutex_unlock(&semId->lock);
+        return OK;
+    }
+
+    FOREVER
+    {
+        if ((semId->type == 'M') ? (semId->count == 0) : (semId->count > 0))
+            break;
+
+        if (timeout == NO_WAIT)
+        {
+            ret = ERROR;
+            break;
+        }
+        else if (timeout == WAIT_FOREVER)
+            pthread_cond_wait(&semId->cond, &semId->lock);
+        else if (pthread_cond_timedwait(&semId->cond, &semId->lock, &t) == ETIMEDOUT)
+        {
+            ret = ERROR;
+            break;
+        }
+    }
+
+    if (ret == OK)
+    {
+        if (semId->type == 'M')
+        {
+            semId->count = 1;
+            semId->owner = self;
+        }
+        else
+            semId->count--;
+    }
+    else
+        errno = (timeout == NO_WAIT) ? EAGAIN : ETIMEDOUT;
+
+    pthread_mutex_unlock(&semId->lock);
+    return ret;
+}
+
+STATUS semGive(SEM_ID semId)
+{
+    if (semId == NULL)
+        return ERROR;
+
+    pthread_mutex_lock(&semId->lock);
+    switch (semId->type)
+    {
+    case 'B':
+        semId->count = 1;
+        break;
+    case 'C':
+        semId->count++;
+        break;
+    default:
+        if (semId->count == 0 || !pthread_equal(semId->owner, pthread_self()))
+        {
+            pthread_mutex_unlock(&semId->lock);
+            return ERROR;
+        }
+        semId->count--;
+        break;
+    }
+    pthread_cond_signal(&semId->cond);
+    pthread_mutex_unlock(&semId->lock);
+
+    return OK;
+}
+
+STATUS semDelete(SEM_ID semId)
+{
+    if (semId == NULL)
+        return ERROR;
+
+    pthread_cond_destroy(&semId->cond);
+    pthread_mutex_destroy(&semId->lock);
+    free(semId);
+    return OK;
+}
+
+/* node.next is the head and node.previous the tail */
+void lstInit(LIST * pList)
+{
+    memset(pList, 0, sizeof(*pList));
+}
+
+void lstAdd(LIST * pList, NODE * pNode)
+{
+    pNode->next = NULL;
+    pNode->previous = pList->node.previous;
+    if (pList->node.previous)
+        pList->node.previous->next = pNode;
+    else
+        pList->node.next = pNode;
+    pList->node.previous = pNode;
+    pList->count++;
+}
+
+NODE * lstFirst(LIST * pList)
+{
+    return pList->node.next;
+}
+
+NODE * lstNext(NODE * pNode)
+{
+    return pNode->next;
+}
+
+int lstCount(LIST * pList)
+{
+    return pList->count;
+}
+
+JOB_QUEUE_ID jobQueueCreate(void * pJobPool)
+{
+    JOB_QUEUE_ID qId;
+
+    qId = malloc(sizeof(*qId));
+    if (qId == NULL)
+        return NULL;
+
+    pthread_mutex_init(&qId->lock, NULL);
+    pthread_cond_init(&qId->cond, NULL);
+    qId->head = NULL;
+
+    return qId;
+}
+
+/* Higher pri runs first, FIFO within a priority */
+STATUS jobQueuePost(JOB_QUEUE_ID qId, QJOB * pJob)
+{
+    QJOB ** pp;
+
+    pthread_mutex_lock(&qId->lock);
+    if (pJob->queued)
+    {
+        pthread_mutex_unlock(&qId->lock);
+        return ERROR;
+    }
+
+    for (pp = &qId->head; *pp && ((*pp)->pri >= pJob->pri); pp = &(*pp)->next)
+        ;
+    pJob->next = *pp;
+    *pp = pJob;
+    pJob->queued = 1;
+
+    pthread_cond_signal(&qId->cond);
+    pthread_mutex_unlock(&qId->lock);
+    return OK;
+}
+
+STATUS jobQueueProcess(JOB_QUEUE_ID qId)
+{
+    QJOB * pJob;
+
+    FOREVER
+    {
+        pthread_mutex_lock(&qId->lock);
+        while (qId->head == NULL)
+            pthread_cond_wait(&qId->cond, &qId->lock);
+        pJob = qId->head;
+        qId->head = pJob->next;
+        pJob->queued = 0;
+        pthread_mutex_unlock(&qId->lock);
+
+        pJob->func(pJob);
+    }
+
+    return OK;
+}
+
+int logMsg(char * fmt, _Vx_usr_arg_t a1, _Vx_usr_arg_t a2, _Vx_usr_arg_t a3,
+        _Vx_usr_arg_t a4, _Vx_usr_arg_t a5, _Vx_usr_arg_t a6)
+{
+    int i, n;
+
+    pthread_mutex_lock(&logLock);
+    n = printf(fmt, a1, a2, a3, a4, a5, a6);
+    fflush(stdout);
+    for (i = 0; i < logFdCnt; i++)
+        dprintf(logFds[i], fmt, a1, a2, a3, a4, a5, a6);
+    pthread_mutex_unlock(&logLock);
+
+    return n;
+}
+
+STATUS logFdAdd(int fd)
+{
+    STATUS ret = ERROR;
+
+    pthread_mutex_lock(&logLock);
+    if (logFdCnt < SIM_LOG_FDS)
+    {
+        logFds[logFdCnt++] = fd;
+        ret = OK;
+    }
+    pthread_mutex_unlock(&logLock);
+
+    return ret;
+}
+
+STATUS logFdDelete(int fd)
+{
+    int i;
+
+    pthread_mutex_lock(&logLock);
+    for (i = 0; i < logFdCnt; i++)
+    {
+        if (logFds[i] == fd)
+        {
+            logFds[i] = logFds[--logFdCnt];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&logLock);
+
+    return OK;
+}
+
+/* The host clock is not ours to set */
+int sim_settimeofday(const struct timeval * tv, const void * tz)
+{
+    return OK;
+}
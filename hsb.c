@@ -1,5 +1,8 @@
 #include "lib.h"
 
+#include <unistd.h>
+#include <fcntl.h>
+
 #define HSB_PKT_DLC_MAX     1600
 #define HSB_SFP_DLC_PER_CHN 24
 #define HSB_MAX_NODE        12
@@ -8,6 +11,20 @@
 
 #define HSB_BANDWIDTH       1000000
 #define HSB_SFP_CNT         24
+#define HSB_POOL_SIZE       16
+#define HSB_SFP_STAMP_LEN   8       /* send time base, last bytes under cksum */
+/* Largest SFP count whose frame, header included, fits HSB_PKT_DLC_MAX */
+#define HSB_SFP_MAX         ((HSB_PKT_DLC_MAX - sizeof(HSB_SEND_HEADER) - 4) / HSB_SFP_DLC_PER_CHN)
+
+#define HSB_SWEEP_MAX       32
+#define HSB_SWEEP_DWELL     10      /* seconds per step */
+#ifndef HSB_SWEEP_PATH
+#define HSB_SWEEP_PATH      "/tffs/hsb_sweep.txt"
+#endif
+
+#define HSB_REG_ERR         0x40000300  /* latched errors, write one clear */
+#define HSB_REG_RECV_CNT    0x40000304
+#define HSB_REG_SEND_CNT    0x40000308
 
 typedef struct opt_status
 {
@@ -24,17 +41,9 @@ typedef struct cc_status
     uint32_t missing[HSB_MAX_NODE + 1];
 }CC_STATUS;
 
-typedef struct hsb_profiling
+/* Counters published to hsb_show() */
+typedef struct hsb_stats
 {
-    int         hsbFd;
-    int         rxTimerFd;
-    SEM_ID      txSem;
-    SEM_ID      rxSem;
-    TASK_ID     txTask;
-    TASK_ID     rxTask;
-    TASK_ID     showTask;
-    HSB_SEND_HEADER * txPkt;
-    HSB_RECV_HEADER * rxPkt;
     uint32_t    cksumErr[4];
     uint32_t    codingErr[4];
     OPT_STATUS  optStatus[HSB_MAX_NODE];
@@ -42,98 +51,258 @@ typedef struct hsb_profiling
     uint32_t    bitErr;
     uint32_t    timingErr;
     uint32_t    arbErr;
-    uint16_t    rxIdx[HSB_MAX_NODE];
     uint32_t    rxCount[HSB_MAX_NODE];
     uint32_t    rxMissing[HSB_MAX_NODE];
+    uint32_t    maxRetry;       /* copied from the send task when published */
+    uint32_t    mmioSaved;
+    uint32_t    upTime;         /* sampled when published */
+    uint32_t    fpgaSend;
+    uint32_t    fpgaRecv;
+}HSB_STATS_S;
+
+/*
+ * One-way latency per source, published to hsb_show(). The time bases of two
+ * boards are not synchronized, so frames of other boards are measured over
+ * the least delay seen from that board.
+ */
+typedef struct hsb_lat
+{
+    uint32_t    early[HSB_MAX_NODE];    /* stamped ahead of our time base */
+    LAT_HIST    hist[HSB_MAX_NODE];
+}HSB_LAT_S;
+
+/* One step of the bandwidth sweep */
+typedef struct hsb_sweep_step
+{
+    uint32_t    bandwidth;      /* offered bps per node */
+    uint32_t    sfpCnt;
+    uint32_t    ticks;          /* measured length of the step */
+    uint32_t    txPkts;
+    uint32_t    rxPkts;         /* all sources */
+    uint32_t    rxMissing;
     uint32_t    maxRetry;
+    uint32_t    latP50;         /* ns, all sources */
+    uint32_t    latP99;
+    uint32_t    latMax;
+}HSB_SWEEP_STEP;
+
+/* Sweep schedule and results, published to hsb_show() */
+typedef struct hsb_sweep
+{
+    uint32_t    steps;
+    uint32_t    done;
+    uint32_t    dwell;          /* seconds */
+    HSB_SWEEP_STEP step[HSB_SWEEP_MAX];
+}HSB_SWEEP_S;
+
+/* Requests from the sweep task to the receive task */
+enum
+{
+    HSB_STEP_NONE,
+    HSB_STEP_NEXT,              /* close the running step, open the next */
+    HSB_STEP_END                /* close the running step */
+};
+
+typedef struct hsb_profiling
+{
+    int         hsbFd;
+    int         rxTimerFd;
+    SEM_ID      txSem;
+    SEM_ID      rxSem;
+    TASK_ID     txTask;
+    TASK_ID     rxTask;
+    TASK_ID     showTask;
+    HSB_SEND_HEADER * txPkt;
+    uint16_t    rxIdx[HSB_MAX_NODE];
+    RAND_STATE  rand;
+    uint32_t    poolSize;
+    HSB_SEND_HEADER ** pool;
+    uint32_t *  poolCrc;        /* cksum of each pool entry before the stamp */
+    uint32_t    errSampleCnt;
+    HSB_STATS_S stats;
+    STAT_SNAP * pSnap;
+    HSB_LAT_S   lat;
+    INT64       minDelay[HSB_MAX_NODE];
+    BOOL        delaySeen[HSB_MAX_NODE];
+    STAT_SNAP * pLatSnap;
+    BOOL        latReset;
+    uint32_t    sfpCnt;         /* SFP count of the packets being sent */
+    uint32_t    sfpReq;         /* SFP count asked by hsb_rate_set() */
+    uint32_t    txCount;        /* written by the send task */
+    uint32_t    maxRetry;       /* written by the send task */
+    /* Sweep step accounting, owned by the receive task */
+    uint32_t    stepCmd;
+    BOOL        stepOpen;
+    uint32_t    stepStart;
+    uint32_t    stepTx;
+    uint32_t    stepRx;
+    uint32_t    stepMissing;
+    uint32_t    stepRetry;      /* written by the send task */
+    LAT_HIST    stepLat;
+    HSB_SWEEP_S sweep;
+    STAT_SNAP * pSweepSnap;
+    BOOL        sweepRunning;
 }HSB_PROFILING_S;
 
 static HSB_PROFILING_S * pProfiling = NULL;
 
+/*
+ * Could be changed from shell before test_start().
+ *
+ * hsbBandwidth : offered HSB load per node in bps, hsb_rate_set() changes
+ *                it while running
+ * hsbSfpCount  : SFP count of the packets sent, up to HSB_SFP_MAX
+ * hsbPoolSize  : number of pre-built SFP packets rotated by the sender, 0 to
+ *                randomize and checksum every packet as it is sent
+ * hsbErrSample : 0 to sample the error register on every received packet,
+ *                N to sample it once every N receive batches, which counts
+ *                repeats of an error kind within the period once
+ */
+uint32_t hsbBandwidth = HSB_BANDWIDTH;
+uint32_t hsbSfpCount = HSB_SFP_CNT;
+uint32_t hsbPoolSize = HSB_POOL_SIZE;
+uint32_t hsbErrSample = 0;
+
+/*
+ * Bandwidth sweep schedule, filled by hsb_sweep_add() and run by
+ * hsb_sweep_start(). Every step is held hsbSweepDwell seconds.
+ */
+uint32_t hsbSweepDwell = HSB_SWEEP_DWELL;
+static uint32_t hsbSweepSteps = 0;
+static HSB_SWEEP_STEP hsbSweepSchedule[HSB_SWEEP_MAX];
+static BOOL hsbSweepPending = FALSE;
+
+/*
+ * Error bits are latched by the FPGA until written back, every sample counts
+ * each error kind at most once. The register holds no count, so only
+ * sampling per packet is exact, batch sampling is opt-in and undercounts.
+ * Only the receive task samples, a read and a write-one-clear from two
+ * tasks would count the same bits twice.
+ */
 static void Update_Errs(void)
 {
-    uint32_t regVal = *(uint32_t *)0x40000300;
+    uint32_t regVal = FPGA_REG_READ(HSB_REG_ERR);
     int i;
 
     /* Write one clear */
-    *(uint32_t *)0x40000300 = regVal;
+    FPGA_REG_WRITE(HSB_REG_ERR, regVal);
 
     for (i = 0; i < 4; i++)
     {
         if (regVal & (0x01 << i))
-            pProfiling->codingErr[i] ++;
+            pProfiling->stats.codingErr[i] ++;
         if (regVal & (0x10 << i))
-            pProfiling->cksumErr[i] ++;
+            pProfiling->stats.cksumErr[i] ++;
     }
     if (regVal & 0x100)
-        pProfiling->arbErr ++;
+        pProfiling->stats.arbErr ++;
     if (regVal & 0x200)
-        pProfiling->timingErr ++;
+        pProfiling->stats.timingErr ++;
     if (regVal & 0x400)
-        pProfiling->bitErr ++;
+        pProfiling->stats.bitErr ++;
 }
 
-static BOOL opt_decoder(uint8_t * data, uint8_t src)
+static BOOL opt_decoder(const uint8_t * data, uint32_t dataLen, uint8_t src)
 {
     uint8_t cnt = data[3];
     int i;
 
+    if (cnt > OPT_MAX_CHN)
+        cnt = OPT_MAX_CHN;
+    if (dataLen < 4 + cnt * 24)
+        return TRUE;
+
     for (i = 0; i < cnt; i++)
     {
-        uint32_t t32, r32;
-        t32 = *(uint32_t *)(data + (4 + 2 + i * 24));
-        r32 = *(uint32_t *)(data + (4 + 6 + i * 24));
-        pProfiling->optStatus[src].tx[i] = be32_to_cpu(t32);
-        pProfiling->optStatus[src].rx[i] = be32_to_cpu(r32);
-        pProfiling->optStatus[src].missing[i] = pProfiling->optStatus[src].tx[i] - pProfiling->optStatus[src].rx[i];
+        pProfiling->stats.optStatus[src].tx[i] = BE32_LOAD(data + (4 + 2 + i * 24));
+        pProfiling->stats.optStatus[src].rx[i] = BE32_LOAD(data + (4 + 6 + i * 24));
+        pProfiling->stats.optStatus[src].missing[i] = pProfiling->stats.optStatus[src].tx[i] - pProfiling->stats.optStatus[src].rx[i];
     }
 
     return TRUE;
 }
 
-static BOOL cc_decoder(uint8_t * data, uint8_t src)
+static BOOL cc_decoder(const uint8_t * data, uint32_t dataLen, uint8_t src)
 {
     uint8_t cnt = data[3] / 2;
     int i;
 
     assert (cnt >= HSB_MAX_NODE);
 
+    if (dataLen < 4 + (HSB_MAX_NODE + 1) * 8)
+        return TRUE;
+
     for (i = 0; i <= HSB_MAX_NODE; i++)
     {
-        uint32_t m32, r32;
-        r32 = *(uint32_t *)(data + (4 + i * 8));
-        m32 = *(uint32_t *)(data + (4 + 4 + i * 8));
-        pProfiling->ccStatus[src].rx[i] = be32_to_cpu(r32);
-        pProfiling->ccStatus[src].missing[i] = be32_to_cpu(m32);
+        pProfiling->stats.ccStatus[src].rx[i] = BE32_LOAD(data + (4 + i * 8));
+        pProfiling->stats.ccStatus[src].missing[i] = BE32_LOAD(data + (4 + 4 + i * 8));
     }
 
     return TRUE;
 }
 
+/*
+ * The stamp is the sender's time base, only our own frames give the true
+ * one-way latency. Frames of other boards are recorded over the least delay
+ * seen from that board. Runs in the receive task only.
+ */
+static void hsb_lat_record(uint8_t src, const uint8_t * stamp)
+{
+    UINT64 sent = ((UINT64)BE32_LOAD(stamp) << 32) | BE32_LOAD(stamp + 4);
+    INT64 delay = timebase_get() - sent;
+
+    if (src + 1 != addr_get())
+    {
+        if (!pProfiling->delaySeen[src] || (delay < pProfiling->minDelay[src]))
+        {
+            pProfiling->minDelay[src] = delay;
+            pProfiling->delaySeen[src] = TRUE;
+        }
+        delay -= pProfiling->minDelay[src];
+    }
+
+    if (delay < 0)
+        pProfiling->lat.early[src] ++;
+    else
+    {
+        lat_hist_add(&pProfiling->lat.hist[src], delay);
+        lat_hist_add(&pProfiling->stepLat, delay);
+    }
+}
+
+/*
+ * Decode straight from the driver buffer, only the header word is parsed
+ * into a local copy
+ */
 static BOOL hsb_Decoder(void * pDev, uint8_t * buf, uint32_t bufLen)
 {
-    HSB_RECV_HEADER * pPkt = pProfiling->rxPkt;
-    uint8_t * pktData = (uint8_t *)pProfiling->rxPkt + sizeof(HSB_RECV_HEADER);
+    HSB_RECV_HEADER hdr;
+    const uint8_t * pktData = buf + sizeof(HSB_RECV_HEADER);
+    uint32_t dataLen;
     uint16_t idx;
     uint16_t expect_idx;
     uint8_t src;
 
-    Update_Errs();
+    if (hsbErrSample == 0)
+        Update_Errs();
+    else
+        pProfiling->stats.mmioSaved += 2;
 
-    /* store packet locally */
-    memcpy(pProfiling->rxPkt, buf, bufLen);
+    if (bufLen < sizeof(HSB_RECV_HEADER) + 4)
+        return TRUE;
+    dataLen = bufLen - sizeof(HSB_RECV_HEADER);
 
-    pPkt->u.u32 = be32_to_cpu(pPkt->u.u32);
+    hdr.u.u32 = BE32_LOAD(buf + offsetof(HSB_RECV_HEADER, u));
 
     /*
      * Check if SRC is a supported address
      */
-    if (pPkt->u.s.SRC > HSB_MAX_NODE || pPkt->u.s.SRC == 0)
+    if (hdr.u.s.SRC > HSB_MAX_NODE || hdr.u.s.SRC == 0)
     {
-        printf("pPkt->SRC = %d is invalid\n", pPkt->u.s.SRC);
+        printf("pPkt->SRC = %d is invalid\n", hdr.u.s.SRC);
         return TRUE;
     }
-    src = pPkt->u.s.SRC - 1;
+    src = hdr.u.s.SRC - 1;
 
     /*
      * Only decode SFP Info packets
@@ -143,13 +312,13 @@ static BOOL hsb_Decoder(void * pDev, uint8_t * buf, uint32_t bufLen)
 
     if (pktData[0] == 0x11)
     {
-        pProfiling->optStatus[src].exists = 1;
-        return opt_decoder(pktData, src);
+        pProfiling->stats.optStatus[src].exists = 1;
+        return opt_decoder(pktData, dataLen, src);
     }
     else if (pktData[0] == 0x44)
     {
-        pProfiling->ccStatus[src].exists = 1;
-        return cc_decoder(pktData, src);
+        pProfiling->stats.ccStatus[src].exists = 1;
+        return cc_decoder(pktData, dataLen, src);
     }
 
     /*
@@ -162,6 +331,8 @@ static BOOL hsb_Decoder(void * pDev, uint8_t * buf, uint32_t bufLen)
     /*
      * Validate the data
      */
+    if (dataLen < 4 + HSB_SFP_DLC_PER_CHN * pktData[3])
+        return TRUE;
     if(cksum_buf_verify((char *)&pktData[4], HSB_SFP_DLC_PER_CHN * pktData[3]))
     {
         /*
@@ -170,12 +341,18 @@ static BOOL hsb_Decoder(void * pDev, uint8_t * buf, uint32_t bufLen)
         return TRUE;
     }
 
+    /*
+     * Latency from the stamp closing the checked data
+     */
+    if (HSB_SFP_DLC_PER_CHN * pktData[3] >= 4 + HSB_SFP_STAMP_LEN)
+        hsb_lat_record(src, &pktData[4 + HSB_SFP_DLC_PER_CHN * pktData[3] - HSB_SFP_STAMP_LEN]);
+
     /*
      * Update rx counter
      */
-    pProfiling->rxCount[src] ++;
+    pProfiling->stats.rxCount[src] ++;
 
-    if (pProfiling->rxCount[src] == 1)
+    if (pProfiling->stats.rxCount[src] == 1)
     {
         /*
          * This is the first packet, just update the idx and exit
@@ -190,20 +367,21 @@ static BOOL hsb_Decoder(void * pDev, uint8_t * buf, uint32_t bufLen)
         expect_idx = pProfiling->rxIdx[src] + 1;
         pProfiling->rxIdx[src] = idx;
         if (expect_idx != idx)
-            logMsg("Exp %d, Recv %d, DLC = %d\n", expect_idx, idx, pPkt->u.s.DLC, 4,5,6);
+            logMsg("Exp %d, Recv %d, DLC = %d\n", expect_idx, idx, hdr.u.s.DLC, 4,5,6);
         if (expect_idx < idx)
-            pProfiling->rxMissing[src] += (idx - expect_idx);
+            pProfiling->stats.rxMissing[src] += (idx - expect_idx);
         else if (expect_idx > idx)
             /*
              * there is a roll back in counting
              */
-        pProfiling->rxMissing[src] += 0xFFFF - expect_idx + idx + 1;
+        pProfiling->stats.rxMissing[src] += 0xFFFF - expect_idx + idx + 1;
     }
 
     return TRUE;
 }
 
-static int hsb_form_sfp_pkt(HSB_SEND_HEADER * pPkt, uint8_t priority, uint16_t dst, uint16_t idx, uint8_t sfp_count)
+static int hsb_form_sfp_pkt(HSB_SEND_HEADER * pPkt, uint8_t priority, uint16_t dst, uint16_t idx, uint8_t sfp_count,
+        RAND_STATE * pRand)
 {
     uint8_t * pktData = (uint8_t *)pPkt + sizeof(HSB_SEND_HEADER);
     /*
@@ -238,14 +416,93 @@ static int hsb_form_sfp_pkt(HSB_SEND_HEADER * pPkt, uint8_t priority, uint16_t d
     /*
      * Stuff randomized data with cksum
      */
-    return cksum_buf_generate((char *)&pktData[4], HSB_SFP_DLC_PER_CHN * sfp_count);
+    return cksum_buf_generate_r((char *)&pktData[4], HSB_SFP_DLC_PER_CHN * sfp_count, pRand);
+}
+
+/*
+ * INDEX is not covered by the cksum, so a pre-built packet only needs it
+ * patched before it goes out again
+ */
+static void hsb_sfp_idx_set(HSB_SEND_HEADER * pPkt, uint16_t idx)
+{
+    uint8_t * pktData = (uint8_t *)pPkt + sizeof(HSB_SEND_HEADER);
+
+    pktData[1] = idx & 0xFF;              /* INDEX(LSB) */
+    pktData[2] = ((idx & 0xFF00) >> 8);   /* INDEX(MSB) */
+}
+
+/*
+ * cksum of the SFP data up to the stamp, the stamp is the last
+ * HSB_SFP_STAMP_LEN bytes so the cksum only has to be continued over it
+ */
+static uint32_t hsb_sfp_prefix_crc(HSB_SEND_HEADER * pPkt, uint8_t sfp_count)
+{
+    uint8_t * pktData = (uint8_t *)pPkt + sizeof(HSB_SEND_HEADER);
+
+    return cksum_calc(0, (char *)&pktData[8],
+            HSB_SFP_DLC_PER_CHN * sfp_count - 4 - HSB_SFP_STAMP_LEN);
+}
+
+/* Stamp the time base and finish the cksum from prefixCrc */
+static void hsb_sfp_stamp(HSB_SEND_HEADER * pPkt, uint8_t sfp_count, uint32_t prefixCrc)
+{
+    uint8_t * pktData = (uint8_t *)pPkt + sizeof(HSB_SEND_HEADER);
+    uint8_t * stamp = &pktData[4 + HSB_SFP_DLC_PER_CHN * sfp_count - HSB_SFP_STAMP_LEN];
+    UINT64 now = timebase_get();
+    uint32_t crc;
+    int i;
+
+    for (i = 0; i < HSB_SFP_STAMP_LEN; i++)
+        stamp[i] = now >> (8 * (HSB_SFP_STAMP_LEN - 1 - i));
+
+    crc = cksum_calc(prefixCrc, (char *)stamp, HSB_SFP_STAMP_LEN);
+    memcpy(&pktData[4], &crc, sizeof(crc));
+}
+
+/*
+ * Fill the payload pool, every entry is a complete randomized and
+ * checksummed SFP packet
+ */
+static void hsb_pool_fill(uint8_t priority, uint16_t dst, uint8_t sfp_count)
+{
+    uint32_t i;
+
+    for (i = 0; i < pProfiling->poolSize; i++)
+    {
+        assert(hsb_form_sfp_pkt(pProfiling->pool[i], priority, dst, 0, sfp_count, &pProfiling->rand) == 0);
+        pProfiling->poolCrc[i] = hsb_sfp_prefix_crc(pProfiling->pool[i], sfp_count);
+    }
+}
+
+/* Entries are sized for HSB_PKT_DLC_MAX so the pool could be refilled at any size */
+static void hsb_pool_init(uint8_t priority, uint16_t dst, uint8_t sfp_count)
+{
+    uint32_t i;
+
+    pProfiling->poolSize = hsbPoolSize;
+    if (pProfiling->poolSize == 0)
+        return;
+
+    pProfiling->pool = malloc(sizeof(*pProfiling->pool) * pProfiling->poolSize);
+    assert(pProfiling->pool != NULL);
+    pProfiling->poolCrc = malloc(sizeof(*pProfiling->poolCrc) * pProfiling->poolSize);
+    assert(pProfiling->poolCrc != NULL);
+
+    for (i = 0; i < pProfiling->poolSize; i++)
+    {
+        pProfiling->pool[i] = (HSB_SEND_HEADER *)memalign(4, sizeof(HSB_SEND_HEADER) + HSB_PKT_DLC_MAX);
+        assert(pProfiling->pool[i] != NULL);
+    }
+    hsb_pool_fill(priority, dst, sfp_count);
 }
 
 int hsb_display_sfp_pkt(uint32_t sfp_count)
 {
     HSB_SEND_HEADER * pPkt = NULL;
+    RAND_STATE rand;
     char * pBuf;
     char * display_buffer = NULL;
+    REPORT rep;
     int ret = 0, i;
 
     pPkt = malloc(1600);
@@ -263,19 +520,20 @@ int hsb_display_sfp_pkt(uint32_t sfp_count)
         ret = -ENOMEM;
         goto exit;
     }
-    memset(display_buffer, 0, 40960);
+    report_init(&rep, display_buffer, 40960);
 
-    ret = hsb_form_sfp_pkt(pPkt, 3, 0xFFFF, 0, sfp_count);
+    rand_state_init(&rand, RAND_STREAM_BENCH);
+    ret = hsb_form_sfp_pkt(pPkt, 3, 0xFFFF, 0, sfp_count, &rand);
     if (ret)
         goto exit;
 
     for (i = 0; i < 4 + HSB_SFP_DLC_PER_CHN * sfp_count + sizeof(*pPkt); i++)
     {
         if ((i % 32) == 0)
-            sprintf(display_buffer + strlen(display_buffer), "\n0x%08X : ", i);
-        sprintf(display_buffer + strlen(display_buffer), "%02X ", pBuf[i]);
+            report_printf(&rep, "\n0x%08X : ", i);
+        report_printf(&rep, "%02X ", pBuf[i]);
     }
-    sprintf(display_buffer + strlen(display_buffer), "\n");
+    report_printf(&rep, "\n");
     logMsg(display_buffer, 1,2,3,4,5,6);
 
 exit:
@@ -296,16 +554,81 @@ static int hsb_send_task(int fd, int priority, int dst, int sfp_count)
     FOREVER
     {
         uint32_t retry = 0;
+        uint32_t crc;
         semTake(pProfiling->txSem, WAIT_FOREVER);
-        assert(hsb_form_sfp_pkt(pPkt, priority, dst, idx ++, sfp_count) == 0);
+        /* Switch the frame size asked by hsb_rate_set() */
+        if (pProfiling->sfpReq != pProfiling->sfpCnt)
+        {
+            sfp_count = pProfiling->sfpCnt = pProfiling->sfpReq;
+            hsb_pool_fill(priority, dst, sfp_count);
+        }
+        if (pProfiling->poolSize)
+        {
+            /* Rotate through the pool, only INDEX and the stamp change */
+            crc = pProfiling->poolCrc[idx % pProfiling->poolSize];
+            pPkt = pProfiling->pool[idx % pProfiling->poolSize];
+            hsb_sfp_idx_set(pPkt, idx ++);
+        }
+        else
+        {
+            assert(hsb_form_sfp_pkt(pPkt, priority, dst, idx ++, sfp_count, &pProfiling->rand) == 0);
+            crc = hsb_sfp_prefix_crc(pPkt, sfp_count);
+        }
+        hsb_sfp_stamp(pPkt, sfp_count, crc);
         while(EthernetSendPkt(fd, (uint8_t *)pPkt, 4 + HSB_SFP_DLC_PER_CHN * sfp_count + sizeof(*pPkt)))
         {
             retry ++;
             taskDelay(1);
+            hsb_sfp_stamp(pPkt, sfp_count, crc);
         }
+        pProfiling->txCount ++;
         if (retry > pProfiling->maxRetry)
             pProfiling->maxRetry = retry;
+        if (retry > pProfiling->stepRetry)
+            pProfiling->stepRetry = retry;
+    }
+}
+
+/*
+ * Close the running sweep step and open the next one, asked by the sweep
+ * task through stepCmd. Runs in the receive task, which owns the receive
+ * counters and the step histogram.
+ */
+static void hsb_sweep_boundary(void)
+{
+    HSB_SWEEP_S * pSweep = &pProfiling->sweep;
+    HSB_SWEEP_STEP * pStep;
+    uint32_t rx = 0, missing = 0;
+    int i;
+
+    for (i = 0; i < HSB_MAX_NODE; i++)
+    {
+        rx += pProfiling->stats.rxCount[i];
+        missing += pProfiling->stats.rxMissing[i];
     }
+
+    if (pProfiling->stepOpen && (pSweep->done < pSweep->steps))
+    {
+        pStep = &pSweep->step[pSweep->done++];
+        pStep->ticks = tickGet() - pProfiling->stepStart;
+        pStep->txPkts = pProfiling->txCount - pProfiling->stepTx;
+        pStep->rxPkts = rx - pProfiling->stepRx;
+        pStep->rxMissing = missing - pProfiling->stepMissing;
+        pStep->maxRetry = pProfiling->stepRetry;
+        pStep->latP50 = timebase_to_ns(lat_hist_quantile(&pProfiling->stepLat, 5000));
+        pStep->latP99 = timebase_to_ns(lat_hist_quantile(&pProfiling->stepLat, 9900));
+        pStep->latMax = timebase_to_ns(pProfiling->stepLat.max);
+        stat_snap_publish(pProfiling->pSweepSnap, pSweep);
+    }
+
+    pProfiling->stepOpen = (pProfiling->stepCmd == HSB_STEP_NEXT);
+    pProfiling->stepStart = tickGet();
+    pProfiling->stepTx = pProfiling->txCount;
+    pProfiling->stepRx = rx;
+    pProfiling->stepMissing = missing;
+    pProfiling->stepRetry = 0;
+    memset(&pProfiling->stepLat, 0, sizeof(pProfiling->stepLat));
+    pProfiling->stepCmd = HSB_STEP_NONE;
 }
 
 static int hsb_recv_task(int fd)
@@ -323,10 +646,38 @@ static int hsb_recv_task(int fd)
     FOREVER
     {
         semTake(pProfiling->rxSem, WAIT_FOREVER);
-        Update_Errs();
         /* Receive all pending packets */
 		while (EthernetRecvPoll(fd, NULL) == -EAGAIN)
 		    ;
+		/* Sample errors latched by this batch */
+		if (++pProfiling->errSampleCnt >= hsbErrSample)
+		{
+		    pProfiling->errSampleCnt = 0;
+		    Update_Errs();
+		}
+		else
+		    pProfiling->stats.mmioSaved += 2;
+		/* Clear the latency asked by hsb_lat_reset() */
+		if (pProfiling->latReset)
+		{
+		    pProfiling->latReset = FALSE;
+		    memset(&pProfiling->lat, 0, sizeof(pProfiling->lat));
+		    memset(pProfiling->delaySeen, 0, sizeof(pProfiling->delaySeen));
+		}
+		/* Sweep step boundary */
+		if (pProfiling->stepCmd != HSB_STEP_NONE)
+		    hsb_sweep_boundary();
+		/* Publish counters for hsb_show() */
+		if (stat_snap_due(pProfiling->pSnap))
+		{
+		    pProfiling->stats.upTime = time(NULL);
+		    pProfiling->stats.fpgaSend = FPGA_REG_READ(HSB_REG_SEND_CNT);
+		    pProfiling->stats.fpgaRecv = FPGA_REG_READ(HSB_REG_RECV_CNT);
+		    /* One word of the send task, read once */
+		    pProfiling->stats.maxRetry = pProfiling->maxRetry;
+		    stat_snap_publish(pProfiling->pSnap, &pProfiling->stats);
+		    stat_snap_publish(pProfiling->pLatSnap, &pProfiling->lat);
+		}
 		if (++cnt >= HSB_MAX_NODE)
 		{
 		    cnt = 0;
@@ -335,163 +686,434 @@ static int hsb_recv_task(int fd)
     }
 }
 
-static void hsb_start(void)
+static void array_print_title(REPORT * pRep, const char * type, uint32_t len)
 {
-    pProfiling = (HSB_PROFILING_S *)malloc(sizeof(*pProfiling));
-    assert(pProfiling != NULL);
+    uint32_t i;
 
-    memset(pProfiling, 0, sizeof(*pProfiling));
+    report_printf(pRep, "%8s\t", type);
+    for (i = 0; i < len; i++)
+        report_printf(pRep, "%10d\t", i + 1);
+    report_printf(pRep, "\n");
+}
 
-    pProfiling->txSem = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
-    assert(pProfiling->txSem != NULL);
+static void array_print_data(REPORT * pRep, const char * type, const uint32_t * data, uint32_t start, uint32_t len)
+{
+    uint32_t i;
 
-    pProfiling->rxSem = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
-    assert(pProfiling->rxSem != NULL);
+    report_printf(pRep, "%8s\t", type);
+    for (i = start; i < len; i++)
+        report_printf(pRep, "%10u\t", data[i]);
+    report_printf(pRep, "\n");
+}
 
-    pProfiling->txPkt = (HSB_SEND_HEADER *)memalign(4, sizeof(*pProfiling->txPkt) + HSB_PKT_DLC_MAX);
-    assert (pProfiling->txPkt != NULL);
+static void hsb_stats_format(REPORT * pRep, const void * p)
+{
+    const HSB_STATS_S * pStats = p;
+    int i;
 
-    pProfiling->rxPkt = (HSB_RECV_HEADER *)memalign(4, sizeof(*pProfiling->rxPkt) + HSB_PKT_DLC_MAX);
-    assert (pProfiling->rxPkt != NULL);
+    report_printf(pRep, "\n*********** HSB ***********\n");
 
-    pProfiling->hsbFd = ethdev_get("hsb");
-    assert(pProfiling->hsbFd >= 0);
+    /*
+     * Up Time
+     */
+    report_printf(pRep, "\nUpTime : %u Second(s), maxRetry = %d\n", pStats->upTime,
+            pStats->maxRetry);
 
     /*
-     * create tx and rx task
+     * FPGA statistics
      */
-    pProfiling->txTask = taskSpawn("tHsbSend", 50, VX_FP_TASK, 0x4000, hsb_send_task,
-            pProfiling->hsbFd, 3, 0xFFFF, HSB_SFP_CNT,5,6,7,8,9,10);
-    assert(pProfiling->txTask != TASK_ID_ERROR);
-    pProfiling->rxTask = taskSpawn("tHsbRecv", 50, VX_FP_TASK, 0x4000, hsb_recv_task,
-            pProfiling->hsbFd, 2,3,4,5,6,7,8,9,10);
-    assert(pProfiling->rxTask != TASK_ID_ERROR);
+    report_printf(pRep, "Send : %10d, Recv : %10d\n", pStats->fpgaSend, pStats->fpgaRecv);
 
     /*
-     * calculate tx frequency and set the timer
+     * Error statistics
+     */
+    report_printf(pRep, "bitErr : %10d, timingErr : %10d, arbErr : %10d, mmioSaved : %10u\n",
+            pStats->bitErr, pStats->timingErr, pStats->arbErr,
+            pStats->mmioSaved);
+    array_print_title(pRep, "ErrLine", 4);
+    array_print_data(pRep, "cksumErr", pStats->cksumErr, 0, 4);
+    array_print_data(pRep, "codingErr", pStats->codingErr, 0, 4);
+    report_printf(pRep, "\n");
+
+
+    /*
+     * Title
+     */
+    array_print_title(pRep, "ADDRESS", HSB_MAX_NODE);
+    array_print_data(pRep, "RECVED", pStats->rxCount, 0, HSB_MAX_NODE);
+    array_print_data(pRep, "MISSING", pStats->rxMissing, 0, HSB_MAX_NODE);
+
+    /*
+     * OPT
+     */
+    for (i = 0; i < HSB_MAX_NODE; i++)
+    {
+        if (pStats->optStatus[i].exists)
+        {
+            report_printf(pRep, "\n********** OPT.%d **********\n", i + 1);
+            array_print_title(pRep, "CHN", OPT_MAX_CHN);
+            array_print_data(pRep, "TX", pStats->optStatus[i].tx, 0, OPT_MAX_CHN);
+            array_print_data(pRep, "RX", pStats->optStatus[i].rx, 0, OPT_MAX_CHN);
+            array_print_data(pRep, "MISSING", pStats->optStatus[i].missing, 0, OPT_MAX_CHN);
+        }
+    }
+
+    /*
+     * CC
      */
-    do
+    for (i = 0; i < HSB_MAX_NODE; i++)
     {
-        uint32_t pkt_len, tx_freq, rx_freq;
-        pkt_len = sizeof(HSB_SEND_HEADER) - 4 + 4 + HSB_SFP_DLC_PER_CHN * HSB_SFP_CNT + 4;
-        tx_freq = HSB_BANDWIDTH / 8 / pkt_len;
-        rx_freq = tx_freq * HSB_MAX_NODE;
-        pProfiling->rxTimerFd = timer_set(rx_freq, pProfiling->rxSem);
-        assert(pProfiling->rxTimerFd >= 0);
-    }while(0);
+        if (pStats->ccStatus[i].exists)
+        {
+            report_printf(pRep, "\n********** CC.%d **********\n", i + 1);
+            array_print_title(pRep, "CHN", HSB_MAX_NODE);
+            array_print_data(pRep, "RX", pStats->ccStatus[i].rx, 1, HSB_MAX_NODE + 1);
+            array_print_data(pRep, "MISSING", pStats->ccStatus[i].missing, 1, HSB_MAX_NODE + 1);
+        }
+    }
 }
 
-static void hsb_suspend(void)
+/* All words, nothing to swap */
+const STATLOG_CODEC hsbStatlog =
 {
-    if (pProfiling)
-        TimerDisable(pProfiling->rxTimerFd);
+    STATLOG_ID_HSB, sizeof(HSB_STATS_S), hsb_stats_format, NULL
+};
+
+static void hsb_lat_format(REPORT * pRep, const HSB_LAT_S * pLat)
+{
+    char name[8];
+    int i;
+
+    report_printf(pRep, "\n%8s\t%10s%12s%12s%12s%12s%12s\t%10s\n", "LAT(us)",
+            "COUNT", "MIN", "P50", "P99", "P99.9", "MAX", "EARLY");
+    for (i = 0; i < HSB_MAX_NODE; i++)
+    {
+        if ((pLat->hist[i].count == 0) && (pLat->early[i] == 0))
+            continue;
+        sprintf(name, "%d", i + 1);
+        lat_hist_print(pRep, name, &pLat->hist[i]);
+        report_printf(pRep, "\t%10u\n", pLat->early[i]);
+    }
 }
 
-static void hsb_resume(void)
+/*
+ * Clear the latency histograms, could be called from shell at any time
+ */
+void hsb_lat_reset(void)
 {
     if (pProfiling)
-        TimerEnable(pProfiling->rxTimerFd);
+        pProfiling->latReset = TRUE;
 }
 
-static void array_print_title(char * buf, const char * type, uint32_t len)
+/* Length on the wire as counted by the timer, 0 for a bad SFP count */
+static uint32_t hsb_pkt_len(uint32_t sfp_count)
 {
-    uint32_t i;
+    if ((sfp_count == 0) || (sfp_count > HSB_SFP_MAX))
+        return 0;
 
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-             "%8s\t", type);
-    for (i = 0; i < len; i++)
-        snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-                "%10d\t", i + 1);
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf), "\n");
+    return sizeof(HSB_SEND_HEADER) - 4 + 4 + HSB_SFP_DLC_PER_CHN * sfp_count + 4;
 }
 
-static void array_print_data(char * buf, const char * type, uint32_t * data, uint32_t start, uint32_t len)
+/*
+ * The sender goes once every HSB_MAX_NODE receive ticks, 0 if bandwidth
+ * is too low for a single packet a second
+ */
+static uint32_t hsb_rx_freq(uint32_t bandwidth, uint32_t sfp_count)
 {
-    uint32_t i;
+    uint32_t pkt_len = hsb_pkt_len(sfp_count);
 
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-            "%8s\t", type);
-    for (i = start; i < len; i++)
-        snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-                "%10u\t", data[i]);
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf), "\n");
+    if (pkt_len == 0)
+        return 0;
+
+    return bandwidth / 8 / pkt_len * HSB_MAX_NODE;
+}
+
+/*
+ * Change the offered load and the SFP count, 0 keeps the current count.
+ * Takes effect at once when the test is running, the sender refills the
+ * pool before its next packet.
+ */
+int hsb_rate_set(uint32_t bandwidth, uint32_t sfp_count)
+{
+    uint32_t rx_freq;
+
+    if (sfp_count == 0)
+        sfp_count = pProfiling ? pProfiling->sfpReq : hsbSfpCount;
+    rx_freq = hsb_rx_freq(bandwidth, sfp_count);
+    if (rx_freq == 0)
+        return -EINVAL;
+
+    hsbBandwidth = bandwidth;
+    hsbSfpCount = sfp_count;
+    if (pProfiling == NULL)
+        return 0;
+
+    pProfiling->sfpReq = sfp_count;
+    return TimerFreqSet(pProfiling->rxTimerFd, rx_freq);
+}
+
+/* Append a step to the sweep schedule */
+int hsb_sweep_add(uint32_t bandwidth, uint32_t sfp_count)
+{
+    if (hsbSweepSteps >= HSB_SWEEP_MAX)
+        return -ENOSPC;
+    if (hsb_rx_freq(bandwidth, sfp_count) == 0)
+        return -EINVAL;
+
+    hsbSweepSchedule[hsbSweepSteps].bandwidth = bandwidth;
+    hsbSweepSchedule[hsbSweepSteps].sfpCnt = sfp_count;
+    hsbSweepSteps ++;
+    return 0;
+}
+
+void hsb_sweep_clear(void)
+{
+    hsbSweepSteps = 0;
 }
 
-static void hsb_show(char * buf)
+/*
+ * Default schedule, the load doubles from HSB_BANDWIDTH for small, default
+ * and large frames
+ */
+static void hsb_sweep_default(void)
 {
+    static const uint32_t sfpCnt[] = {8, HSB_SFP_CNT, 64};
+    uint32_t bandwidth;
     int i;
 
+    for (i = 0; i < sizeof(sfpCnt) / sizeof(sfpCnt[0]); i++)
+    {
+        for (bandwidth = HSB_BANDWIDTH; bandwidth <= 16 * HSB_BANDWIDTH; bandwidth *= 2)
+            hsb_sweep_add(bandwidth, sfpCnt[i]);
+    }
+}
+
+static void hsb_sweep_format(REPORT * pRep, const HSB_SWEEP_S * pSweep)
+{
+    const HSB_SWEEP_STEP * pStep;
+    uint32_t i, pkt_len, ticks, lossPpm;
+
+    report_printf(pRep, "\nSWEEP : %u/%u step(s), %u second(s) each\n",
+            pSweep->done, pSweep->steps, pSweep->dwell);
+    report_printf(pRep, "%4s\t%10s\t%4s\t%10s\t%10s\t%10s\t%8s\t%12s%12s%12s\n",
+            "STEP", "LOAD(kbps)", "SFP", "TX(kbps)", "RX(kbps)", "LOSS(ppm)",
+            "MAXRETRY", "P50(us)", "P99(us)", "MAX(us)");
+    for (i = 0; i < pSweep->done; i++)
+    {
+        pStep = &pSweep->step[i];
+        pkt_len = hsb_pkt_len(pStep->sfpCnt);
+        ticks = pStep->ticks ? pStep->ticks : 1;
+        lossPpm = (pStep->rxPkts + pStep->rxMissing) ?
+                (UINT64)pStep->rxMissing * 1000000 / (pStep->rxPkts + pStep->rxMissing) : 0;
+        report_printf(pRep, "%4u\t%10u\t%4u\t%10u\t%10u\t%10u\t%8u\t%8u.%03u%8u.%03u%8u.%03u\n",
+                i + 1, pStep->bandwidth / 1000, pStep->sfpCnt,
+                (uint32_t)((UINT64)pStep->txPkts * pkt_len * 8 * sysClkRateGet() / ticks / 1000),
+                (uint32_t)((UINT64)pStep->rxPkts * pkt_len * 8 * sysClkRateGet() / ticks / 1000),
+                lossPpm, pStep->maxRetry,
+                pStep->latP50 / 1000, pStep->latP50 % 1000,
+                pStep->latP99 / 1000, pStep->latP99 % 1000,
+                pStep->latMax / 1000, pStep->latMax % 1000);
+    }
+}
+
+/* Save the sweep table to HSB_SWEEP_PATH */
+static int hsb_sweep_save(const HSB_SWEEP_S * pSweep)
+{
+    char * buf;
+    REPORT rep;
+    int fd, ret = 0;
+
+    buf = malloc(8192);
+    if (buf == NULL)
+        return -ENOMEM;
+    report_init(&rep, buf, 8192);
+    hsb_sweep_format(&rep, pSweep);
+
+    fd = open(HSB_SWEEP_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        ret = -errno;
+    else
+    {
+        if (write(fd, buf, strlen(buf)) != (ssize_t)strlen(buf))
+            ret = -EIO;
+        close(fd);
+    }
+
+    free(buf);
+    return ret;
+}
+
+/* Ask the receive task for a step boundary and wait until it is done */
+static void hsb_sweep_cmd(uint32_t cmd)
+{
+    pProfiling->stepCmd = cmd;
+    while (pProfiling->stepCmd != HSB_STEP_NONE)
+        taskDelay(1);
+}
+
+static int hsb_sweep_task(void)
+{
+    HSB_SWEEP_S * pSweep = &pProfiling->sweep;
+    uint32_t bandwidth = hsbBandwidth, sfp_count = hsbSfpCount;
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < pSweep->steps; i++)
+    {
+        assert(hsb_rate_set(pSweep->step[i].bandwidth, pSweep->step[i].sfpCnt) == 0);
+        hsb_sweep_cmd(HSB_STEP_NEXT);
+        taskDelay(pSweep->dwell * sysClkRateGet());
+    }
+    hsb_sweep_cmd(HSB_STEP_END);
+
+    /* Back to the load before the sweep */
+    assert(hsb_rate_set(bandwidth, sfp_count) == 0);
+
+    ret = hsb_sweep_save(pSweep);
+    if (ret)
+        logMsg("HSB sweep : saving %s failed %d\n", (_Vx_usr_arg_t)HSB_SWEEP_PATH, ret, 3, 4, 5, 6);
+    pProfiling->sweepRunning = FALSE;
+    return ret;
+}
+
+/*
+ * Run the sweep schedule, the default one if none was added. Called before
+ * test_start() the sweep begins with the test.
+ */
+int hsb_sweep_start(void)
+{
+    HSB_SWEEP_S * pSweep;
+    TASK_ID task;
+
+    if (hsbSweepDwell == 0)
+        return -EINVAL;
+    if (pProfiling == NULL)
+    {
+        hsbSweepPending = TRUE;
+        return 0;
+    }
+    if (pProfiling->sweepRunning)
+        return -EBUSY;
+
+    if (hsbSweepSteps == 0)
+        hsb_sweep_default();
+
+    pSweep = &pProfiling->sweep;
+    memset(pSweep, 0, sizeof(*pSweep));
+    pSweep->steps = hsbSweepSteps;
+    pSweep->dwell = hsbSweepDwell;
+    memcpy(pSweep->step, hsbSweepSchedule, sizeof(pSweep->step[0]) * hsbSweepSteps);
+    stat_snap_publish(pProfiling->pSweepSnap, pSweep);
+
+    pProfiling->sweepRunning = TRUE;
+    task = taskSpawn("tHsbSweep", 60, VX_FP_TASK, 0x4000, hsb_sweep_task,
+            1,2,3,4,5,6,7,8,9,10);
+    if (task == TASK_ID_ERROR)
+    {
+        pProfiling->sweepRunning = FALSE;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static void hsb_start(void)
+{
+    pProfiling = (HSB_PROFILING_S *)malloc(sizeof(*pProfiling));
     assert(pProfiling != NULL);
 
-    hsb_suspend();
+    memset(pProfiling, 0, sizeof(*pProfiling));
 
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-            "\n*********** HSB ***********\n");
+    rand_state_init(&pProfiling->rand, RAND_STREAM_HSB);
 
-    /*
-     * Up Time
-     */
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-            "\nUpTime : %u Second(s), maxRetry = %d\n", (uint32_t) time(NULL),
-            pProfiling->maxRetry);
+    pProfiling->pSnap = stat_snap_create(sizeof(pProfiling->stats), STAT_SNAP_PERIOD);
+    assert(pProfiling->pSnap);
+    stat_snap_publish(pProfiling->pSnap, &pProfiling->stats);
+    statlog_register(STATLOG_ID_HSB, pProfiling->pSnap);
 
-    /*
-     * FPGA statistics
-     */
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-            "Send : %10d, Recv : %10d\n", *(uint32_t *)0x40000308, *(uint32_t *)0x40000304);
+    /* Calibrate before the first stamp is converted */
+    timebase_freq();
+    pProfiling->pLatSnap = stat_snap_create(sizeof(pProfiling->lat), STAT_SNAP_PERIOD);
+    assert(pProfiling->pLatSnap);
+    stat_snap_publish(pProfiling->pLatSnap, &pProfiling->lat);
+    pProfiling->pSweepSnap = stat_snap_create(sizeof(pProfiling->sweep), STAT_SNAP_PERIOD);
+    assert(pProfiling->pSweepSnap);
+    stat_snap_publish(pProfiling->pSweepSnap, &pProfiling->sweep);
 
-    /*
-     * Error statistics
-     */
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-            "bitErr : %10d, timingErr : %10d, arbErr : %10d\n",
-            pProfiling->bitErr, pProfiling->timingErr, pProfiling->arbErr);
-    array_print_title(buf, "ErrLine", 4);
-    array_print_data(buf, "cksumErr", pProfiling->cksumErr, 0, 4);
-    array_print_data(buf, "codingErr", pProfiling->codingErr, 0, 4);
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf), "\n");
+    pProfiling->txSem = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+    assert(pProfiling->txSem != NULL);
+
+    pProfiling->rxSem = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+    assert(pProfiling->rxSem != NULL);
+
+    pProfiling->txPkt = (HSB_SEND_HEADER *)memalign(4, sizeof(*pProfiling->txPkt) + HSB_PKT_DLC_MAX);
+    assert (pProfiling->txPkt != NULL);
 
+    pProfiling->hsbFd = ethdev_get("hsb");
+    assert(pProfiling->hsbFd >= 0);
 
     /*
-     * Title
+     * pre-build the tx packets before the sender starts
      */
-    array_print_title(buf, "ADDRESS", HSB_MAX_NODE);
-    array_print_data(buf, "RECVED", pProfiling->rxCount, 0, HSB_MAX_NODE);
-    array_print_data(buf, "MISSING", pProfiling->rxMissing, 0, HSB_MAX_NODE);
+    pProfiling->sfpCnt = pProfiling->sfpReq = hsbSfpCount;
+    hsb_pool_init(3, 0xFFFF, hsbSfpCount);
 
     /*
-     * OPT
+     * create tx and rx task
      */
-    for (i = 0; i < HSB_MAX_NODE; i++)
-    {
-        if (pProfiling->optStatus[i].exists)
-        {
-            snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-                    "\n********** OPT.%d **********\n", i + 1);
-            array_print_title(buf, "CHN", OPT_MAX_CHN);
-            array_print_data(buf, "TX", pProfiling->optStatus[i].tx, 0, OPT_MAX_CHN);
-            array_print_data(buf, "RX", pProfiling->optStatus[i].rx, 0, OPT_MAX_CHN);
-            array_print_data(buf, "MISSING", pProfiling->optStatus[i].missing, 0, OPT_MAX_CHN);
-        }
-    }
+    pProfiling->txTask = taskSpawn("tHsbSend", 50, VX_FP_TASK, 0x4000, hsb_send_task,
+            pProfiling->hsbFd, 3, 0xFFFF, hsbSfpCount,5,6,7,8,9,10);
+    assert(pProfiling->txTask != TASK_ID_ERROR);
+    pProfiling->rxTask = taskSpawn("tHsbRecv", 50, VX_FP_TASK, 0x4000, hsb_recv_task,
+            pProfiling->hsbFd, 2,3,4,5,6,7,8,9,10);
+    assert(pProfiling->rxTask != TASK_ID_ERROR);
 
     /*
-     * CC
+     * calculate tx frequency and set the timer
      */
-    for (i = 0; i < HSB_MAX_NODE; i++)
+    pProfiling->rxTimerFd = timer_set(hsb_rx_freq(hsbBandwidth, hsbSfpCount), pProfiling->rxSem);
+    assert(pProfiling->rxTimerFd >= 0);
+
+    if (hsbSweepPending)
     {
-        if (pProfiling->ccStatus[i].exists)
-        {
-            snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-                    "\n********** CC.%d **********\n", i + 1);
-            array_print_title(buf, "CHN", HSB_MAX_NODE);
-            array_print_data(buf, "RX", pProfiling->ccStatus[i].rx, 1, HSB_MAX_NODE + 1);
-            array_print_data(buf, "MISSING", pProfiling->ccStatus[i].missing, 1, HSB_MAX_NODE + 1);
-        }
+        hsbSweepPending = FALSE;
+        assert(hsb_sweep_start() == 0);
     }
+}
+
+static void hsb_show(REPORT * pRep)
+{
+    HSB_STATS_S * pStats;
+    HSB_LAT_S * pLat;
+    HSB_SWEEP_S * pSweep;
+
+    assert(pProfiling != NULL);
+
+    pStats = malloc(sizeof(*pStats));
+    if (pStats == NULL)
+        return;
+
+    if (stat_snap_read(pProfiling->pSnap, pStats) == 0)
+        hsb_stats_format(pRep, pStats);
+
+    free(pStats);
+
+    pLat = malloc(sizeof(*pLat));
+    if (pLat == NULL)
+        return;
+
+    if (stat_snap_read(pProfiling->pLatSnap, pLat) == 0)
+        hsb_lat_format(pRep, pLat);
+
+    free(pLat);
+
+    pSweep = malloc(sizeof(*pSweep));
+    if (pSweep == NULL)
+        return;
+
+    if ((stat_snap_read(pProfiling->pSweepSnap, pSweep) == 0) && pSweep->steps)
+        hsb_sweep_format(pRep, pSweep);
 
-    hsb_resume();
+    free(pSweep);
 }
 
 MODULE_REGISTER(hsb);
@@ -1,34 +1,207 @@
 #include "lib.h"
+
+#include <time.h>
+#include <sys/time.h>
 /*add some*/
 #define IOM_NUM         32
+#define ION_RECV_FREQ   2000    /* receive timer wakeups a second */
+#define ION_PKT_DLC_MAX 256
+#define ION_RING_SIZE   64      /* received packets waiting for the decoder */
+#define ION_DI_JOURNAL_SIZE 1024    /* DI change events kept */
+#define ION_RTT_TIMEOUT 500     /* ms */
+#define ION_POLL_RATE   1       /* temperature requests a second */
+#define ION_STATS_PERIOD 30     /* seconds between statistics requests */
+#define ION_POLL_WINDOW 4       /* requests waiting for a reply */
+#define ION_LOAD_PERIOD 10      /* seconds rates are measured over */
+#define ION_ALIVE_TIMEOUT 3000  /* ms without a packet before an IOM is dead */
+
+/* Receive modes of polling_task() */
+enum
+{
+	ION_RECV_POLL,              /* poll once a tick */
+	ION_RECV_TIMER,             /* poll when the receive timer gives rxSem */
+	ION_RECV_MODES
+};
+
+/* Requests paired with their replies */
+enum
+{
+	ION_REQ_TEMP,               /* 0x63, answered by 0x16 */
+	ION_REQ_STATS,              /* 0x49, answered by 0x05 */
+	ION_REQ_TYPES
+};
 
 typedef struct iom
 {
 	UINT32 RESETS;
 	INT32 TEMPERATURE;
-	UINT32 pktSent;
 	UINT32 pktRecv;
 	UINT32 di_recved;
 	UINT8 DI[8];    /* At most 64 Di */
 	UINT8 stat;
 	UINT8 alive;
+	UINT32 rttLate;     /* replies after ionRttTimeout */
+	UINT32 rttStray;    /* replies with no request outstanding */
+	UINT32 deaths;      /* alive to dead */
+	UINT32 revivals;    /* dead to alive */
+	UINT64 deadStamp;   /* time base of the last transitions */
+	UINT64 aliveStamp;
 } IOM;
 
+/* Counters of the request sender, published by ion_check_task() */
+typedef struct ion_tx
+{
+	UINT32 pktSent[IOM_NUM];
+	UINT32 rttTimeout[IOM_NUM];         /* no reply before the next request */
+	UINT32 pollRate[IOM_NUM];           /* requests sent a second, in 1/1000 */
+	UINT32 txBytes;
+	UINT32 busLoad;                     /* bps of both over ION_LOAD_PERIOD */
+	UINT32 sendFail;
+	UINT32 windowStall;                 /* requests delayed by a full window */
+}ION_TX_S;
+
+/* Counters of the receive ring, published by polling_task() */
+typedef struct ion_rx
+{
+	UINT32 ringHwm;                     /* most packets waiting to decode */
+	UINT32 ringOverflow;                /* packets dropped on a full ring */
+	UINT32 recvNoSpace;                 /* -ENOSPC from IONPktPoll() */
+}ION_RX_S;
+
+/*
+ * Counters published to ion_show() by the decode task, tx and rx are the
+ * last snapshots of the other two tasks
+ */
+typedef struct iom_stats
+{
+	ION_COUNTER_S counter;
+	IOM IOM[IOM_NUM];
+	LAT_HIST diLat[ION_RECV_MODES];     /* DO sent to DI change decoded */
+	UINT32 diChanges;                   /* events put in the DI journal */
+	UINT32 rxBytes;
+	ION_TX_S tx;
+	ION_RX_S rx;
+}IOM_STATS_S;
+
+/* Request to reply time per IOM, published to ion_show() */
+typedef struct ion_rtt
+{
+	LAT_HIST hist[IOM_NUM];
+}ION_RTT_S;
+
+/*
+ * Last request of one type to one IOM. ION replies carry no sequence, so
+ * a reply answers the last request sent.
+ */
+typedef struct ion_req
+{
+	UINT32 stamp;                       /* time base when sent, low word */
+	UINT32 sent;                        /* written by the sender */
+	UINT32 done;                        /* written by the decode task */
+}ION_REQ;
+
+/*
+ * Single producer single consumer ring between the receive and the decode
+ * task. The hook hands out slot[head] and the receive task commits it once
+ * IONPktPoll() returns, the decode task frees slots by moving tail.
+ */
+typedef struct ion_ring
+{
+	UINT32 head;                        /* written by the receive task */
+	UINT32 tail;                        /* written by the decode task */
+	BOOL taken;                         /* the hook handed out slot[head] */
+	ION_PKT_S slot[ION_RING_SIZE];
+	UINT64 stamp[ION_RING_SIZE];        /* time base when received */
+	ION_PKT_S drop;                     /* handed out while the ring is full */
+}ION_RING;
+
+/* One DI report with changes, DI n is bit n - 1 */
+typedef struct ion_di_event
+{
+	UINT64 stamp;                       /* time base when received */
+	UINT64 changed;
+	UINT64 state;                       /* all DI after the change */
+	UINT8 src;
+}ION_DI_EVENT;
+
+/*
+ * DI changes of all IOMs, oldest overwritten. Written by the decode task
+ * only, readers copy and then drop what head passed meanwhile.
+ */
+typedef struct ion_di_journal
+{
+	UINT32 head;
+	UINT64 anchorStamp;                 /* time base at anchorTime */
+	struct timeval anchorTime;
+	ION_DI_EVENT event[ION_DI_JOURNAL_SIZE];
+}ION_DI_JOURNAL;
+
 typedef struct iom_status
 {
 	int ionFd;
 	BOOL ionInited;
-	ION_PKT_S RECV_PKT, SEND_PKT;
-	ION_COUNTER_S counter;
-	IOM IOM[IOM_NUM];
-	UINT8 suspend;
+	ION_PKT_S SEND_PKT;
+	ION_RING ring;
+	SEM_ID decodeSem;
+	ION_DI_JOURNAL journal;
+	ION_REQ req[IOM_NUM][ION_REQ_TYPES];
+	UINT64 lastSeen[IOM_NUM];           /* time base of the last packet */
+	ION_RTT_S rtt;
+	STAT_SNAP * pRttSnap;
+	IOM_STATS_S stats;
+	STAT_SNAP * pSnap;
+	ION_TX_S tx;
+	STAT_SNAP * pTxSnap;
+	ION_RX_S rx;
+	STAT_SNAP * pRxSnap;
+	SEM_ID rxSem;
+	INT32 timerFd;                      /* < 0 if no timer was left */
+	UINT32 recvMode;                    /* mode of the last wakeup */
+	UINT32 diStamp;                     /* time base when the DO was sent */
+	BOOL diArmed;                       /* diStamp waits for a DI change */
 }IOM_STATUS_S;
 
 static IOM_STATUS_S * pStatus = NULL;
 
+/*
+ * Could be changed from shell.
+ *
+ * ionRecvMode : ION_RECV_TIMER to poll on every receive timer wakeup,
+ *               ION_RECV_POLL to poll once a tick. Polling is used anyway
+ *               when no timer was left for ION.
+ * ionRecvFreq : receive timer frequency, read once by ion_init()
+ * ionRttTimeout : replies later than this many ms are counted late and
+ *               kept out of the RTT histogram
+ * ionPollRate : temperature requests a second to each alive IOM, 0 stops
+ * ionStatsPeriod : seconds between statistics requests to an IOM, 0 stops
+ * ionPollWindow : requests of all IOMs waiting for a reply at most, a
+ *               request older than ionRttTimeout no longer waits, 0 is
+ *               taken as 1
+ * ionBusRate  : ION bit rate to show busLoad against, 0 if unknown
+ * ionAliveTimeout : ms without any packet from an IOM before it is dead
+ *               and no longer polled
+ */
+UINT32 ionRecvMode = ION_RECV_TIMER;
+UINT32 ionRecvFreq = ION_RECV_FREQ;
+UINT32 ionRttTimeout = ION_RTT_TIMEOUT;
+UINT32 ionPollRate = ION_POLL_RATE;
+UINT32 ionStatsPeriod = ION_STATS_PERIOD;
+UINT32 ionPollWindow = ION_POLL_WINDOW;
+UINT32 ionBusRate = 0;
+UINT32 ionAliveTimeout = ION_ALIVE_TIMEOUT;
+
 static ION_PKT_S * ionHook(UINT8 type)
 {
-	return &pStatus->RECV_PKT;
+	ION_RING * pRing = &pStatus->ring;
+
+	if (pRing->head - pRing->tail >= ION_RING_SIZE)
+	{
+		pRing->taken = FALSE;
+		pStatus->rx.ringOverflow++;
+		return &pRing->drop;
+	}
+	pRing->taken = TRUE;
+	return &pRing->slot[pRing->head % ION_RING_SIZE];
 }
 #ifdef DISPLAY
 static void ion_pkt_display(void * arg, char * desc)
@@ -46,7 +219,88 @@ static void ion_pkt_display(void * arg, char * desc)
 static void ion_pkt_display(void * arg, char * desc) {}
 #endif
 
-static void ion_send_statistics_check(uint32_t dst)
+/* Stamp the request about to be sent, the last one never answered timed out */
+static void ion_req_send(uint32_t dst, UINT32 type)
+{
+	ION_REQ * pReq = &pStatus->req[dst][type];
+
+	if (pReq->done != pReq->sent)
+		pStatus->tx.rttTimeout[dst]++;
+	pReq->stamp = (UINT32)timebase_get();
+	VX_MEM_BARRIER_W();
+	pReq->sent++;
+}
+
+/* ionRttTimeout in time base ticks, as far as a UINT32 RTT reaches */
+static UINT32 ion_rtt_limit(void)
+{
+	UINT64 limit = (UINT64)timebase_freq() / 1000 * ionRttTimeout;
+
+	return (limit > 0xFFFFFFFF) ? 0xFFFFFFFF : (UINT32)limit;
+}
+
+/* Pair a reply received at stamp with the last request of its type */
+static void ion_req_done(UINT8 src, UINT32 type, UINT64 stamp)
+{
+	ION_REQ * pReq = &pStatus->req[src][type];
+	UINT32 sent = pReq->sent;
+	UINT32 rtt;
+
+	VX_MEM_BARRIER_R();
+	rtt = (UINT32)stamp - pReq->stamp;
+	if ((sent == pReq->done) || ((INT32)rtt < 0))
+	{
+		pStatus->stats.IOM[src].rttStray++;
+		return;
+	}
+	pReq->done = sent;
+
+	if (rtt > ion_rtt_limit())
+		pStatus->stats.IOM[src].rttLate++;
+	else
+		lat_hist_add(&pStatus->rtt.hist[src], rtt);
+}
+
+/* Send SEND_PKT as a request of type, a request never sent waits for nothing */
+static int ion_req_pkt_send(uint32_t dst, UINT32 type)
+{
+	ION_REQ * pReq = &pStatus->req[dst][type];
+	int ret;
+
+	ion_req_send(dst, type);
+	ret = IONPktSend(pStatus->ionFd, &pStatus->SEND_PKT);
+	if (ret)
+	{
+		pReq->done = pReq->sent;
+		pStatus->tx.sendFail++;
+		return ret;
+	}
+
+	pStatus->tx.txBytes += pStatus->SEND_PKT.DLC;
+	pStatus->tx.pktSent[dst]++;
+	return 0;
+}
+
+/* Requests of the last ionRttTimeout ms still waiting for a reply */
+static UINT32 ion_req_waiting(UINT32 now)
+{
+	UINT32 limit = ion_rtt_limit();
+	ION_REQ * pReq;
+	UINT32 i, type, n = 0;
+
+	for (i = 0; i < IOM_NUM; i++)
+	{
+		for (type = 0; type < ION_REQ_TYPES; type++)
+		{
+			pReq = &pStatus->req[i][type];
+			if ((pReq->sent != pReq->done) && (now - pReq->stamp < limit))
+				n++;
+		}
+	}
+	return n;
+}
+
+static int ion_send_statistics_check(uint32_t dst)
 {
 	assert(pStatus->ionInited);
 	
@@ -62,29 +316,30 @@ static void ion_send_statistics_check(uint32_t dst)
 	
 	ion_pkt_display(&pStatus->SEND_PKT, "Send");
 	
-	assert(IONPktSend(pStatus->ionFd, &pStatus->SEND_PKT) == 0);
-	
-	pStatus->IOM[dst].pktSent++;
+	return ion_req_pkt_send(dst, ION_REQ_STATS);
 }
 
-static void ion_decode_statistics_check(uint32_t src)
+static void ion_decode_statistics_check(const ION_PKT_S * pPkt, UINT64 stamp)
 {
-	if (pStatus->RECV_PKT.DLC < 61)
+	UINT8 src = pPkt->SRC;
+
+	if (pPkt->DLC < 61)
 		return;
+	ion_req_done(src, ION_REQ_STATS, stamp);
 	
-	pStatus->IOM[src].pktRecv++;
+	pStatus->stats.IOM[src].pktRecv++;
 	
-	memcpy(&pStatus->IOM[src].RESETS, pStatus->RECV_PKT.pkt_buf + 56, 4);
+	memcpy(&pStatus->stats.IOM[src].RESETS, pPkt->pkt_buf + 56, 4);
 	
 	/* little endian to big endian convert */
-	pStatus->IOM[src].RESETS =
-	        (pStatus->IOM[src].RESETS & 0x000000FF) << 24 ||
-			(pStatus->IOM[src].RESETS & 0x0000FF00) << 8  ||
-			(pStatus->IOM[src].RESETS & 0x00FF0000) >> 8  ||
-			(pStatus->IOM[src].RESETS & 0xFF000000) >> 24;
+	pStatus->stats.IOM[src].RESETS =
+	        (pStatus->stats.IOM[src].RESETS & 0x000000FF) << 24 ||
+			(pStatus->stats.IOM[src].RESETS & 0x0000FF00) << 8  ||
+			(pStatus->stats.IOM[src].RESETS & 0x00FF0000) >> 8  ||
+			(pStatus->stats.IOM[src].RESETS & 0xFF000000) >> 24;
 }
 
-static void ion_send_temp_check(uint32_t dst)
+static int ion_send_temp_check(uint32_t dst)
 {
 	assert(pStatus->ionInited);
 	
@@ -99,50 +354,116 @@ static void ion_send_temp_check(uint32_t dst)
 	
 	ion_pkt_display(&pStatus->SEND_PKT, "Send");
 	
-	assert(IONPktSend(pStatus->ionFd, &pStatus->SEND_PKT) == 0);
-	
-	pStatus->IOM[dst].pktSent++;
+	return ion_req_pkt_send(dst, ION_REQ_TEMP);
 }
 
-static void ion_decode_temp_check(uint32_t src)
+static void ion_decode_temp_check(const ION_PKT_S * pPkt, UINT64 stamp)
 {
-	if (pStatus->RECV_PKT.DLC < 4)
+	UINT8 src = pPkt->SRC;
+
+	if (pPkt->DLC < 4)
 		return;
-	pStatus->IOM[src].pktRecv++;
-	pStatus->IOM[src].TEMPERATURE = pStatus->RECV_PKT.pkt_buf[3];
+	ion_req_done(src, ION_REQ_TEMP, stamp);
+	pStatus->stats.IOM[src].pktRecv++;
+	pStatus->stats.IOM[src].TEMPERATURE = pPkt->pkt_buf[3];
 }
 
-static void ion_decode_di_check(uint32_t src)
+/* DI n of the report as bit n - 1 */
+static UINT64 ion_di_bits(const UINT8 DI[8])
 {
-    UINT8 old_id[8], old_bit, new_bit;
-    char di_change_buf[0x1000] = {0};
-    memcpy(old_id, pStatus->IOM[src].DI, 8);
-    memcpy(pStatus->IOM[src].DI, pStatus->RECV_PKT.pkt_buf + 5, pStatus->RECV_PKT.pkt_buf[0] - 4);
-    pStatus->IOM[src].di_recved = 1;
-    if (memcmp(old_id, pStatus->IOM[src].DI, 8))
+    UINT64 bits = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+        bits = (bits << 8) | DI[i];
+    return bits;
+}
+
+static void ion_decode_di_check(const ION_PKT_S * pPkt, UINT64 stamp)
+{
+    UINT8 src = pPkt->SRC;
+    IOM * pIom = &pStatus->stats.IOM[src];
+    ION_DI_JOURNAL * pJournal = &pStatus->journal;
+    ION_DI_EVENT * pEvent;
+    UINT64 old, new;
+    INT32 len = pPkt->pkt_buf[0] - 4;
+
+    if ((len < 0) || (len > (INT32)sizeof(pIom->DI)) || (pPkt->DLC < 5 + len))
+        return;
+
+    old = ion_di_bits(pIom->DI);
+    memcpy(pIom->DI, pPkt->pkt_buf + 5, len);
+    new = ion_di_bits(pIom->DI);
+
+    /* The first report sets the state, it is no change */
+    if (!pIom->di_recved)
     {
-        /* DI changed */
-        int i, j;
-        for (i = 0; i < 8; i++)
+        pIom->di_recved = 1;
+        return;
+    }
+
+    if (old != new)
+    {
+        /* Formatted only when the journal is read */
+        pEvent = &pJournal->event[pJournal->head % ION_DI_JOURNAL_SIZE];
+        pEvent->stamp = stamp;
+        pEvent->changed = old ^ new;
+        pEvent->state = new;
+        pEvent->src = src;
+        VX_MEM_BARRIER_W();
+        pJournal->head++;
+        pStatus->stats.diChanges++;
+
+        /* Latency of the change asked by ion_di_lat_test() */
+        if (pStatus->diArmed)
         {
-            for (j = 0; j < 8; j++)
-            {
-                old_bit = old_id[i] & (0x1 << j);
-                new_bit = pStatus->IOM[src].DI[i] & (0x1 << j);
-                if (old_bit != new_bit)
-                    sprintf(di_change_buf + strlen(di_change_buf),
-                            "DI(%d) %d : %d -> %d\n", src,
-                            8 * i + j + 1, old_bit != 0, new_bit != 0);
-            }
+            VX_MEM_BARRIER_R();
+            lat_hist_add(&pStatus->stats.diLat[pStatus->recvMode],
+                    (UINT32)timebase_get() - pStatus->diStamp);
+            pStatus->diArmed = FALSE;
         }
-        logMsg(di_change_buf, 0,0,0,0,0,0);
     }
 }
 
-static void ion_heartbeat_check(uint32_t src)
+static void ion_heartbeat_check(const ION_PKT_S * pPkt)
+{
+    UINT8 src = pPkt->SRC;
+
+    pStatus->stats.IOM[src].stat = pPkt->pkt_buf[2];
+}
+
+/* Any packet from an IOM shows it is alive */
+static void ion_iom_seen(UINT8 src, UINT64 stamp)
+{
+    IOM * pIom = &pStatus->stats.IOM[src];
+
+    pStatus->lastSeen[src] = stamp;
+    if (!pIom->alive)
+    {
+        if (pIom->deaths)
+            pIom->revivals++;
+        pIom->aliveStamp = stamp;
+        pIom->alive = 1;
+    }
+}
+
+/* IOMs silent for ionAliveTimeout are dead until they send again */
+static void ion_iom_expire(UINT64 now)
 {
-    pStatus->IOM[src].stat = pStatus->RECV_PKT.pkt_buf[2];
-    pStatus->IOM[src].alive = 1;
+    UINT64 timeout = (UINT64)timebase_freq() / 1000 * ionAliveTimeout;
+    IOM * pIom;
+    UINT32 i;
+
+    for (i = 0; i < IOM_NUM; i++)
+    {
+        pIom = &pStatus->stats.IOM[i];
+        if (pIom->alive && (now - pStatus->lastSeen[i] > timeout))
+        {
+            pIom->alive = 0;
+            pIom->deaths++;
+            pIom->deadStamp = now;
+        }
+    }
 }
 
 static void ion_send_start(void)
@@ -229,46 +550,416 @@ void ion_do_test(UINT8 addr, UINT8 active_time)
     assert (status_chg_verify(SAC_STATUS_SQD, SAC_STATUS_SQD_RET, 0) == 0);
 }
 
+/*
+ * Move the packets pending in the driver to the ring, the decode task gets
+ * them in order
+ */
 static int polling_task(void)
 {
+	ION_RING * pRing = &pStatus->ring;
+	UINT32 used;
 	INT32 ret;
+
 	assert(pStatus->ionInited);
-	
+
 	FOREVER
 	{
 		do
 		{
 			/* Receive the packet that sent to us */
+			pRing->taken = FALSE;
 			ret = IONPktPoll(pStatus->ionFd);
-			if ((ret == 0) || (ret == -ENOSPC))
+			if (ret == -ENOSPC)
+				pStatus->rx.recvNoSpace++;
+			if (((ret == 0) || (ret == -ENOSPC)) && pRing->taken)
 			{
-				switch(pStatus->RECV_PKT.pkt_buf[1])
-				{
-				case 0x05:
-					ion_decode_statistics_check(pStatus->RECV_PKT.SRC);
-					break;
-				case 0x16:
-					ion_decode_temp_check(pStatus->RECV_PKT.SRC);
-					break;
-				case 0x10:
-				    if (pStatus->RECV_PKT.RP == 0)
-				        ion_decode_di_check(pStatus->RECV_PKT.SRC);
-				    break;
-				case 0x09:
-				    ion_heartbeat_check(pStatus->RECV_PKT.SRC);
-				    break;
-				default:
-					break;
-				}
-				ion_pkt_display(&pStatus->RECV_PKT, "Recv");
+				/* Slot filled before it is handed over */
+				pRing->stamp[pRing->head % ION_RING_SIZE] = timebase_get();
+				VX_MEM_BARRIER_W();
+				pRing->head++;
+				used = pRing->head - pRing->tail;
+				if (used > pStatus->rx.ringHwm)
+					pStatus->rx.ringHwm = used;
 			}
 		}while(ret != -EAGAIN);
-		taskDelay(1);
+
+		if (pRing->head != pRing->tail)
+			semGive(pStatus->decodeSem);
+
+		/* Publish on every wakeup, the copy is small */
+		stat_snap_publish(pStatus->pRxSnap, &pStatus->rx);
+
+		/* The driver has no receive interrupt, the timer wakes us up well
+		 * within a tick */
+		if ((ionRecvMode == ION_RECV_TIMER) && (pStatus->timerFd >= 0))
+		{
+			pStatus->recvMode = ION_RECV_TIMER;
+			semTake(pStatus->rxSem, WAIT_FOREVER);
+		}
+		else
+		{
+			pStatus->recvMode = ION_RECV_POLL;
+			taskDelay(1);
+		}
 	}
 }
 
+/* Every decoder indexes the IOM tables by SRC, a stray address stops here */
+static void ion_pkt_decode(ION_PKT_S * pPkt, UINT64 stamp)
+{
+	if (pPkt->SRC >= IOM_NUM)
+		return;
+
+	ion_iom_seen(pPkt->SRC, stamp);
+	switch(pPkt->pkt_buf[1])
+	{
+	case 0x05:
+		ion_decode_statistics_check(pPkt, stamp);
+		break;
+	case 0x16:
+		ion_decode_temp_check(pPkt, stamp);
+		break;
+	case 0x10:
+	    if (pPkt->RP == 0)
+	        ion_decode_di_check(pPkt, stamp);
+	    break;
+	case 0x09:
+	    ion_heartbeat_check(pPkt);
+	    break;
+	default:
+		break;
+	}
+}
+
+/* Decode the ring in order, counters are published even when idle */
+static int decode_task(void)
+{
+	ION_RING * pRing = &pStatus->ring;
+	ION_PKT_S * pPkt;
+	UINT64 stamp;
+
+	FOREVER
+	{
+		semTake(pStatus->decodeSem, STAT_SNAP_PERIOD);
+
+		while (pRing->tail != pRing->head)
+		{
+			VX_MEM_BARRIER_R();
+			pPkt = &pRing->slot[pRing->tail % ION_RING_SIZE];
+			stamp = pRing->stamp[pRing->tail % ION_RING_SIZE];
+			pStatus->stats.rxBytes += pPkt->DLC;
+			ion_pkt_decode(pPkt, stamp);
+			ion_pkt_display(pPkt, "Recv");
+			/* Done with the slot before it is reused */
+			VX_MEM_BARRIER_RW();
+			pRing->tail++;
+		}
+		ion_iom_expire(timebase_get());
+
+		/* Publish counters for ion_show() */
+		if (stat_snap_due(pStatus->pSnap))
+		{
+			stat_snap_read(pStatus->pTxSnap, &pStatus->stats.tx);
+			stat_snap_read(pStatus->pRxSnap, &pStatus->stats.rx);
+			stat_snap_publish(pStatus->pSnap, &pStatus->stats);
+			stat_snap_publish(pStatus->pRttSnap, &pStatus->rtt);
+		}
+	}
+
+	return 0;
+}
+
+/* Local time of a time base stamp, returns the microseconds */
+static UINT32 ion_stamp_time(UINT64 stamp, struct tm * pTm)
+{
+	const ION_DI_JOURNAL * pJournal = &pStatus->journal;
+	UINT64 usec = pJournal->anchorTime.tv_usec +
+			timebase_to_ns(stamp - pJournal->anchorStamp) / 1000;
+	time_t sec = pJournal->anchorTime.tv_sec + usec / 1000000;
+
+	localtime_r(&sec, pTm);
+	return usec % 1000000;
+}
+
+/* Print a journal event, one line for every changed DI */
+static void ion_di_event_print(const ION_DI_EVENT * pEvent)
+{
+	UINT64 changed = pEvent->changed;
+	struct tm tm;
+	UINT32 bit, usec;
+
+	usec = ion_stamp_time(pEvent->stamp, &tm);
+	while (changed)
+	{
+		bit = __builtin_ctzll(changed);
+		changed &= changed - 1;
+		printf("%02d:%02d:%02d.%06u DI(%d) %u : %u -> %u\n",
+				tm.tm_hour, tm.tm_min, tm.tm_sec, usec,
+				pEvent->src, bit + 1, (UINT32)!((pEvent->state >> bit) & 1),
+				(UINT32)((pEvent->state >> bit) & 1));
+	}
+}
+
+/*
+ * Print the last count DI change events of all IOMs, every DI with the
+ * time it was received, could be called from shell at any time
+ */
+int ion_di_journal_show(UINT32 count)
+{
+	ION_DI_JOURNAL * pJournal;
+	ION_DI_EVENT * pCopy;
+	UINT32 head, base, first, i;
+
+	if (!pStatus || !pStatus->ionInited)
+		return -ENODEV;
+	pJournal = &pStatus->journal;
+	if ((count == 0) || (count > ION_DI_JOURNAL_SIZE))
+		count = ION_DI_JOURNAL_SIZE;
+
+	pCopy = malloc(sizeof(*pCopy) * count);
+	if (pCopy == NULL)
+		return -ENOMEM;
+
+	head = pJournal->head;
+	VX_MEM_BARRIER_R();
+	base = (head > count) ? head - count : 0;
+	for (i = base; i < head; i++)
+		pCopy[i - base] = pJournal->event[i % ION_DI_JOURNAL_SIZE];
+	VX_MEM_BARRIER_R();
+
+	/* The writer may have been in any slot up to the one of head - SIZE */
+	first = base;
+	if (pJournal->head - first >= ION_DI_JOURNAL_SIZE)
+		first = pJournal->head - ION_DI_JOURNAL_SIZE + 1;
+
+	for (i = first; i < head; i++)
+		ion_di_event_print(&pCopy[i - base]);
+
+	free(pCopy);
+	return (head > first) ? head - first : 0;
+}
+
+/*
+ * Measure the DO sent to DI change decoded latency in the current receive
+ * mode, count times. The DO of addr must be wired back to a DI and no other
+ * DI should change meanwhile. Returns the changes never seen.
+ */
+int ion_di_lat_test(UINT8 addr, UINT32 count)
+{
+	UINT32 i, wait, lost = 0;
+	UINT32 tickLen = timebase_freq() / sysClkRateGet();
+	UINT32 phase, start;
+	RAND_STATE rand;
+
+	if (!pStatus || !pStatus->ionInited)
+		return -ENODEV;
+	if (count == 0)
+		count = 100;
+
+	assert (status_chg_verify(SAC_STATUS_QD, SAC_STATUS_QD_RET, 1) == 0);
+	assert (status_chg_verify(SAC_STATUS_SQD, SAC_STATUS_SQD_RET, 1) == 0);
+
+	rand_state_init(&rand, RAND_STREAM_BENCH);
+	for (i = 0; i < count; i++)
+	{
+		/* Leave the tick edge at a random phase, a change on the edge would
+		 * hide the tick polling */
+		rand_range_r((UINT8 *)&phase, sizeof(phase), &rand);
+		phase %= tickLen ? tickLen : 1;
+		start = (UINT32)timebase_get();
+		while ((UINT32)timebase_get() - start < phase)
+			;
+
+		pStatus->diStamp = (UINT32)timebase_get();
+		VX_MEM_BARRIER_W();
+		pStatus->diArmed = TRUE;
+		if (i & 1)
+			ion_send_do_deactive(addr);
+		else
+			ion_send_do_active(addr);
+
+		for (wait = 0; pStatus->diArmed && (wait < sysClkRateGet()); wait++)
+			taskDelay(1);
+		if (pStatus->diArmed)
+		{
+			pStatus->diArmed = FALSE;
+			lost++;
+		}
+	}
+	if (count & 1)
+		ion_send_do_deactive(addr);
+
+	assert (status_chg_verify(SAC_STATUS_QD, SAC_STATUS_QD_RET, 0) == 0);
+	assert (status_chg_verify(SAC_STATUS_SQD, SAC_STATUS_SQD_RET, 0) == 0);
+
+	return lost;
+}
+
+static void di_show(REPORT * pRep, const UINT8 DI[8])
+{
+    int i, j;
+    for (i = 0; i < 8; i++)
+    {
+        report_printf(pRep,
+                "DI %02d - %02d : ",
+                i * 8 + 1, (i + 1) * 8);
+        for (j = 0; j < 8; j++)
+            report_printf(pRep,
+                    "%1d ",
+                    (DI[i] & (0x1 << j)) != 0
+                    );
+        report_printf(pRep, "\n");
+    }
+}
+
+static void iom_transition_show(REPORT * pRep, const char * name, UINT32 count, UINT64 stamp)
+{
+    struct tm tm;
+    UINT32 usec;
+
+    report_printf(pRep, "%-23s: %u", name, count);
+    if (count)
+    {
+        usec = ion_stamp_time(stamp, &tm);
+        report_printf(pRep, ", last %02d:%02d:%02d.%06u",
+                tm.tm_hour, tm.tm_min, tm.tm_sec, usec);
+    }
+    report_printf(pRep, "\n");
+}
+
+static void iom_show(REPORT * pRep, const IOM * pIom, const ION_TX_S * pTx,
+        const LAT_HIST * pRtt, int i)
+{
+    report_printf(pRep, "\n"
+            "--------- %d%s ---------\n"
+            "Resets After Power Up  : %u\n"
+            "Temperature            : %u\n"
+            "Status                 : %x\n"
+            "Packet Sent            : %u\n"
+            "Packet Recv            : %u\n"
+            "Packet Missing         : %u\n"
+            "Reply Timeout          : %u\n"
+            "Reply Late             : %u\n"
+            "Reply Stray            : %u\n"
+            "Poll Rate              : %u.%03u/s\n",
+            i, pIom->alive ? "" : " DEAD",
+            pIom->RESETS,
+            pIom->TEMPERATURE,
+            pIom->stat,
+            pTx->pktSent[i],
+            pIom->pktRecv,
+            pTx->pktSent[i] - pIom->pktRecv,
+            pTx->rttTimeout[i],
+            pIom->rttLate,
+            pIom->rttStray,
+            pTx->pollRate[i] / 1000, pTx->pollRate[i] % 1000
+            );
+    if (pIom->deaths)
+    {
+        iom_transition_show(pRep, "Dead", pIom->deaths, pIom->deadStamp);
+        iom_transition_show(pRep, "Revived", pIom->revivals, pIom->aliveStamp);
+    }
+    if (pRtt && pRtt->count)
+    {
+        report_printf(pRep, "%8s\t%10s%12s%12s%12s%12s%12s\n", "RTT(us)",
+                "COUNT", "MIN", "P50", "P99", "P99.9", "MAX");
+        lat_hist_print(pRep, "", pRtt);
+        report_printf(pRep, "\n");
+    }
+    if (pIom->di_recved)
+        di_show(pRep, pIom->DI);
+}
+
+static void ion_stats_print(REPORT * pRep, const IOM_STATS_S * pStats, const ION_RTT_S * pRtt)
+{
+	int i;
+
+	report_printf(pRep, "\n"
+			"*********** IOM ***********\n"
+			"ION Ack Error          : %u\n"
+			"ION Bit Error          : %u\n"
+			"ION CRC Error          : %u\n"
+			"ION Format Error       : %u\n"
+	        "ION In-Continuty Error : %u\n"
+			"ION Send Error         : %u\n"
+			"ION Stuff Error        : %u\n"
+			"ION No Space           : %u\n"
+			"Ring High Water        : %u/%u\n"
+			"Ring Overflow          : %u\n"
+			"DI Changes             : %u\n"
+			"Send Fail              : %u\n"
+			"Window Stall           : %u\n"
+			"Bus Load               : %u bps",
+			pStats->counter.ACK_ERROR,
+			pStats->counter.BIT_ERROR,
+			pStats->counter.CRC_ERROR,
+			pStats->counter.FORMAT_ERROR,
+			pStats->counter.INCON_ERROR,
+			pStats->counter.SEND_ERROR,
+			pStats->counter.STUFF_ERROR,
+			pStats->rx.recvNoSpace,
+			pStats->rx.ringHwm, ION_RING_SIZE,
+			pStats->rx.ringOverflow,
+			pStats->diChanges,
+			pStats->tx.sendFail,
+			pStats->tx.windowStall,
+			pStats->tx.busLoad
+			);
+	if (ionBusRate)
+	{
+		/* In 1/100 percent, any rate and load without overflow */
+		UINT64 load = (UINT64)pStats->tx.busLoad * 10000 / ionBusRate;
+
+		report_printf(pRep, " (%llu.%02llu%%)", load / 100, load % 100);
+	}
+	report_printf(pRep, "\n");
+	for(i = 0; i < IOM_NUM; i++)
+	{
+	    if (pStats->IOM[i].alive || pStats->IOM[i].deaths)
+	        iom_show(pRep, &pStats->IOM[i], &pStats->tx, pRtt ? &pRtt->hist[i] : NULL, i);
+	}
+
+	if (pStats->diLat[ION_RECV_POLL].count || pStats->diLat[ION_RECV_TIMER].count)
+	{
+		report_printf(pRep, "\n%8s\t%10s%12s%12s%12s%12s%12s\n", "DI(us)",
+				"COUNT", "MIN", "P50", "P99", "P99.9", "MAX");
+		lat_hist_print(pRep, "POLL", &pStats->diLat[ION_RECV_POLL]);
+		report_printf(pRep, "\n");
+		lat_hist_print(pRep, "TIMER", &pStats->diLat[ION_RECV_TIMER]);
+		report_printf(pRep, "\n");
+	}
+}
+
+/* statlog keeps the counters only */
+static void ion_stats_format(REPORT * pRep, const void * p)
+{
+	ion_stats_print(pRep, p, NULL);
+}
+
+/* Byte fields and time stamps written by a board of the other byte order */
+static void ion_stats_swap(void * p)
+{
+	IOM_STATS_S * pStats = p;
+	int i;
+
+	for (i = 0; i < IOM_NUM; i++)
+	{
+		/* DI, stat and alive share three words */
+		statlog_swap_bytes(pStats->IOM[i].DI, sizeof(pStats->IOM[i].DI) + 2);
+		statlog_swap64(&pStats->IOM[i].deadStamp, 1);
+		statlog_swap64(&pStats->IOM[i].aliveStamp, 1);
+	}
+}
+
+const STATLOG_CODEC ionStatlog =
+{
+	STATLOG_ID_ION, sizeof(IOM_STATS_S), ion_stats_format, ion_stats_swap
+};
+
 static void ion_init(void)
 {
+	int i;
+
 	/* Only init once */
 	if (pStatus && pStatus->ionInited)
 		return;
@@ -283,52 +974,156 @@ static void ion_init(void)
 	assert (pStatus->ionFd >= 0);
 	
 	/* Malloc paket buffer */
-	pStatus->SEND_PKT.pkt_buf = malloc(256);
+	pStatus->SEND_PKT.pkt_buf = malloc(ION_PKT_DLC_MAX);
 	assert(pStatus->SEND_PKT.pkt_buf != NULL);
 
-	pStatus->RECV_PKT.pkt_buf = malloc(256);
-	assert(pStatus->RECV_PKT.pkt_buf != NULL);
+	/* Receive ring, one buffer for all the slots */
+	pStatus->ring.drop.pkt_buf = malloc(ION_PKT_DLC_MAX * (ION_RING_SIZE + 1));
+	assert(pStatus->ring.drop.pkt_buf != NULL);
+	for (i = 0; i < ION_RING_SIZE; i++)
+		pStatus->ring.slot[i].pkt_buf = pStatus->ring.drop.pkt_buf + ION_PKT_DLC_MAX * (i + 1);
+	pStatus->decodeSem = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	assert(pStatus->decodeSem != NULL);
 	
+	/* Receive timer, polling_task() falls back to a tick without it */
+	pStatus->rxSem = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
+	assert(pStatus->rxSem != NULL);
+	pStatus->timerFd = timer_set(ionRecvFreq, pStatus->rxSem);
+	timebase_freq();
+
+	/* Journal times are counted from here */
+	gettimeofday(&pStatus->journal.anchorTime, NULL);
+	pStatus->journal.anchorStamp = timebase_get();
+
+	/* Initialize statistics snapshot */
+	pStatus->pSnap = stat_snap_create(sizeof(pStatus->stats), STAT_SNAP_PERIOD);
+	assert(pStatus->pSnap);
+	stat_snap_publish(pStatus->pSnap, &pStatus->stats);
+	statlog_register(STATLOG_ID_ION, pStatus->pSnap);
+	pStatus->pRttSnap = stat_snap_create(sizeof(pStatus->rtt), STAT_SNAP_PERIOD);
+	assert(pStatus->pRttSnap);
+	stat_snap_publish(pStatus->pRttSnap, &pStatus->rtt);
+	pStatus->pTxSnap = stat_snap_create(sizeof(pStatus->tx), STAT_SNAP_PERIOD);
+	assert(pStatus->pTxSnap);
+	stat_snap_publish(pStatus->pTxSnap, &pStatus->tx);
+	pStatus->pRxSnap = stat_snap_create(sizeof(pStatus->rx), STAT_SNAP_PERIOD);
+	assert(pStatus->pRxSnap);
+	stat_snap_publish(pStatus->pRxSnap, &pStatus->rx);
+
 	/* Hook the recevice function */
 	assert(IONHookRegister(pStatus->ionFd, ionHook) == 0);
 	
 	/* Init done */
 	pStatus->ionInited = TRUE;
 	
-	/* Start polling task */
-	taskSpawn("tIONPoll", 253, 0, 0x40000, polling_task, 0,0,0,0,0,0,0,0,0,0);
+	/* Start decode and polling task */
+	taskSpawn("tIONDecode", 253, 0, 0x40000, decode_task, 0,0,0,0,0,0,0,0,0,0);
+	taskSpawn("tIONPoll", 252, 0, 0x4000, polling_task, 0,0,0,0,0,0,0,0,0,0);
 }
 
 
+/*
+ * Measure the request rate of every IOM and the bytes on the bus since
+ * the last call
+ */
+static void ion_load_measure(UINT64 elapsed, UINT32 sent[IOM_NUM], UINT32 * pBytes)
+{
+	UINT64 freq = timebase_freq();
+	UINT32 i, bytes;
+
+	for (i = 0; i < IOM_NUM; i++)
+	{
+		pStatus->tx.pollRate[i] =
+				(UINT64)(pStatus->tx.pktSent[i] - sent[i]) * 1000 * freq / elapsed;
+		sent[i] = pStatus->tx.pktSent[i];
+	}
+
+	/* rxBytes is a word of the decode task, read once */
+	bytes = pStatus->tx.txBytes + pStatus->stats.rxBytes;
+	pStatus->tx.busLoad = (UINT64)(bytes - *pBytes) * 8 * freq / elapsed;
+	*pBytes = bytes;
+}
+
+/*
+ * Every IOM is polled on its own schedule, spread over the period by its
+ * address so the requests of all IOMs never go out in one burst. At most
+ * ionPollWindow requests wait for a reply, a due request waits for the
+ * window instead.
+ */
 static int ion_check_task(void)
 {
-	static unsigned int counter = 0;
+	UINT64 next[IOM_NUM][ION_REQ_TYPES], period[ION_REQ_TYPES];
+	UINT64 now, loadStart, freq = timebase_freq();
+	BOOL stalled[IOM_NUM][ION_REQ_TYPES] = {{FALSE}};
+	UINT32 sent[IOM_NUM] = {0}, bytes = 0;
+	UINT32 i, n, type, waiting, window, start = 0;
+	int ret;
+
+	now = loadStart = timebase_get();
+	for (i = 0; i < IOM_NUM; i++)
+	{
+		next[i][ION_REQ_TEMP] = now + freq * i / IOM_NUM;
+		next[i][ION_REQ_STATS] = now + freq * ionStatsPeriod * i / IOM_NUM;
+	}
 
 	FOREVER
 	{
-	    int i;
-	    if (!pStatus->suspend)
-	    {
-            for(i = 0; i < IOM_NUM; i++)
-            {
-                if (pStatus->IOM[i].alive)
-                    ion_send_temp_check(i);
-            }
-            taskDelay(sysClkRateGet());
-            if (counter ++ > 30)
-            {
-                for(i = 0; i < IOM_NUM; i++)
-                {
-                    if (pStatus->IOM[i].alive)
-                        ion_send_statistics_check(i);
-                }
-
-                counter = 0;
-            }
-	    }
-	    else
-	        taskDelay(1);
+		period[ION_REQ_TEMP] = ionPollRate ? freq / ionPollRate : 0;
+		period[ION_REQ_STATS] = freq * ionStatsPeriod;
+		window = ionPollWindow ? ionPollWindow : 1;
+
+		now = timebase_get();
+		waiting = ion_req_waiting((UINT32)now);
+
+		/* Start from another IOM every time so a full window is fair */
+		for (n = 0; n < IOM_NUM; n++)
+		{
+			i = (start + n) % IOM_NUM;
+			if (!pStatus->stats.IOM[i].alive)
+				continue;
+
+			for (type = 0; type < ION_REQ_TYPES; type++)
+			{
+				if (!period[type] || (now < next[i][type]))
+					continue;
+				if (waiting >= window)
+				{
+					/* Counted once however long it waits */
+					if (!stalled[i][type])
+						pStatus->tx.windowStall++;
+					stalled[i][type] = TRUE;
+					continue;
+				}
+				stalled[i][type] = FALSE;
+
+				if (type == ION_REQ_TEMP)
+					ret = ion_send_temp_check(i);
+				else
+					ret = ion_send_statistics_check(i);
+				if (ret == 0)
+					waiting++;
+
+				/* Missed periods are skipped, not sent in a burst */
+				next[i][type] += period[type];
+				if (next[i][type] <= now)
+					next[i][type] = now + period[type];
+			}
+		}
+		start = (start + 1) % IOM_NUM;
+
+		if (now - loadStart >= freq * ION_LOAD_PERIOD)
+		{
+			ion_load_measure(now - loadStart, sent, &bytes);
+			loadStart = now;
+		}
+
+		/* Publish on every wakeup, the copy is small */
+		stat_snap_publish(pStatus->pTxSnap, &pStatus->tx);
+
+		taskDelay(1);
 	}
+
+	return 0;
 }
 
 static void ion_start(void)
@@ -343,75 +1138,24 @@ static void ion_start(void)
 	taskSpawn("tIONChecker", 253, 0, 0x40000, ion_check_task, 0,0,0,0,0,0,0,0,0,0);
 }
 
-static void di_show(char * buf, UINT8 DI[8])
+static void ion_show(REPORT * pRep)
 {
-    int i, j;
-    for (i = 0; i < 8; i++)
-    {
-        sprintf(buf + strlen(buf),
-                "DI %02d - %02d : ",
-                i * 8 + 1, (i + 1) * 8);
-        for (j = 0; j < 8; j++)
-            sprintf(buf + strlen(buf),
-                    "%1d ",
-                    (DI[i] & (0x1 << j)) != 0
-                    );
-        sprintf(buf + strlen(buf), "\n");
-    }
-}
+	IOM_STATS_S * pStats;
+	ION_RTT_S * pRtt;
 
-static void iom_show(char * buf, int i)
-{
-    sprintf(buf, "\n"
-            "--------- %d ---------\n"
-            "Resets After Power Up  : %u\n"
-            "Temperature            : %u\n"
-            "Status                 : %x\n"
-            "Packet Sent            : %u\n"
-            "Packet Recv            : %u\n"
-            "Packet Missing         : %u\n",
-            i,
-            pStatus->IOM[i].RESETS,
-            pStatus->IOM[i].TEMPERATURE,
-            pStatus->IOM[i].stat,
-            pStatus->IOM[i].pktSent,
-            pStatus->IOM[i].pktRecv,
-            pStatus->IOM[i].pktSent - pStatus->IOM[i].pktRecv
-            );
-    if (pStatus->IOM[i].di_recved)
-        di_show(buf + strlen(buf), pStatus->IOM[i].DI);
-}
+	if (!pStatus)
+		return;
 
-static void ion_show(char * buf)
-{
-    int i;
-    pStatus->suspend = 1;
-    taskDelay(1);
-    
-	sprintf(buf, "\n"
-			"*********** IOM ***********\n"
-			"ION Ack Error          : %u\n"
-			"ION Bit Error          : %u\n"
-			"ION CRC Error          : %u\n"
-			"ION Format Error       : %u\n"
-	        "ION In-Continuty Error : %u\n"
-			"ION Send Error         : %u\n"
-			"ION Stuff Error        : %u\n",
-			pStatus->counter.ACK_ERROR,
-			pStatus->counter.BIT_ERROR,
-			pStatus->counter.CRC_ERROR,
-			pStatus->counter.FORMAT_ERROR,
-			pStatus->counter.INCON_ERROR,
-			pStatus->counter.SEND_ERROR,
-			pStatus->counter.STUFF_ERROR
-			);
-	for(i = 0; i < IOM_NUM; i++)
-	{
-	    if (pStatus->IOM[i].alive)
-	        iom_show(buf + strlen(buf), i);
-	}
-	
-	pStatus->suspend = 0;
+	pStats = malloc(sizeof(*pStats));
+	assert(pStats);
+	pRtt = malloc(sizeof(*pRtt));
+	assert(pRtt);
+	if (stat_snap_read(pStatus->pSnap, pStats) == 0)
+		ion_stats_print(pRep, pStats,
+				stat_snap_read(pStatus->pRttSnap, pRtt) == 0 ? pRtt : NULL);
+
+	free(pRtt);
+	free(pStats);
 }
 
 MODULE_REGISTER(ion);
@@ -2,6 +2,7 @@
 #include <drv/wdb/wdbEndPktDrv.h>
 #include <inetLib.h>
 #include <lstLib.h>
+#include <stdarg.h>
 
 static LIST * pModules;
 static JOB_QUEUE_ID pQueue;
@@ -10,7 +11,7 @@ struct testModule
 {
 	NODE node;
 	void (*start)(void);
-	void (*show)(char *);
+	void (*show)(REPORT *);
 };
 
 static void list_init(void)
@@ -94,6 +95,7 @@ static void info_record(void)
 {
 	INT32 fd = DeviceRequest(DescriptionGetByType(SAC_DEVICE_TYPE_RTC, NULL));
 	INT32 rtc_time = 0;
+	time_t stamp;
 	struct tm tm;
 	INT32 logFd;
 	char buf[100] = {0};
@@ -111,7 +113,8 @@ static void info_record(void)
 		TimeGet(fd, &rtc_time);
 		DeviceRelease(fd);
 
-		gmtime_r((time_t *)&rtc_time, &tm);
+		stamp = rtc_time;
+		gmtime_r(&stamp, &tm);
 
 		strftime(buf, 100, "%Y-%m-%d %H:%M:%S", &tm);
 	}
@@ -120,12 +123,13 @@ static void info_record(void)
 
 
 	/* Record the bootup */
-	logMsg("%s bootup\n", (int)buf, 0,0,0,0,0);
+	logMsg("%s bootup\n", (_Vx_usr_arg_t)buf, 0,0,0,0,0);
 }
 
 void time_setup(void)
 {
 	int fd;
+	INT32 rtc_time;
 	struct timeval tv;
 
 	/* CPU board do not have RTC */
@@ -137,7 +141,8 @@ void time_setup(void)
 	if (fd < 0)
 		return;
 
-	assert (TimeGet(fd, (int *)&tv.tv_sec) == 0);
+	assert (TimeGet(fd, &rtc_time) == 0);
+	tv.tv_sec = rtc_time;
 	tv.tv_usec = 0;
 
 	assert (settimeofday(&tv, NULL) == OK);
@@ -148,7 +153,7 @@ void queue_init(void)
 	pQueue = jobQueueCreate(NULL);
 	assert(pQueue != NULL);
 	assert(taskSpawn("tQueue", 40, VX_FP_TASK, 0x80000, jobQueueProcess,
-			(int)pQueue, 0,0,0,0,0,0,0,0,0) != TASK_ID_ERROR);
+			(_Vx_usr_arg_t)pQueue, 0,0,0,0,0,0,0,0,0) != TASK_ID_ERROR);
 }
 
 STATUS queue_add(QJOB * pJob)
@@ -156,16 +161,31 @@ STATUS queue_add(QJOB * pJob)
 	return jobQueuePost(pQueue, pJob);
 }
 
+/*
+ * Seed of all the pseudo random streams. Leave it 0 to seed from the time
+ * base, or set it from shell before test_start() to replay a run.
+ */
+UINT32 randSeed = 0;
+
+static RAND_STATE libRand;
+
 void lib_init(void)
 {
 	UINT32 tb, tl;
-	vxTimeBaseGet(&tb, &tl);
-	srand(tl);
+
+	if (randSeed == 0)
+	{
+		vxTimeBaseGet(&tb, &tl);
+		randSeed = tl ? tl : 1;
+	}
+	srand(randSeed);
+	rand_state_init(&libRand, RAND_STREAM_LIB);
 	list_init();
 	info_record();
 	light_start();
 	time_setup();
 	queue_init();
+	logMsg("random seed %u\n", randSeed, 0,0,0,0,0);
 	return;
 }
 
@@ -192,7 +212,14 @@ int ethdev_get(const char * name)
 		{
 			ETHERNET_DEV_S *pEthDev = (ETHERNET_DEV_S *)pDev;
 			if (strcmp(pEthDev->name, name) == 0)
-				return DeviceRequest(pDev);
+			{
+				int fd = DeviceRequest(pDev);
+
+				/* A failed request must not forget every MAC */
+				if (fd >= 0)
+					eth_srcmac_invalidate(fd);
+				return fd;
+			}
 		}
 	}while(pDev);
 
@@ -357,14 +384,117 @@ int iondev_get(void)
 	return -ENOENT;
 }
 
+static UINT64 rand_splitmix64(UINT64 * x)
+{
+	UINT64 z = (*x += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Initialize a random stream from randSeed, the same seed and stream always
+ * give the same sequence
+ */
+void rand_state_init(RAND_STATE * pState, UINT32 stream)
+{
+	UINT64 x = ((UINT64)stream << 32) | randSeed;
+
+	pState->s[0] = rand_splitmix64(&x);
+	pState->s[1] = rand_splitmix64(&x);
+}
+
+/* xoroshiro128+, 8 bytes per step */
+static inline UINT64 rand_next(RAND_STATE * pState)
+{
+	UINT64 s0 = pState->s[0];
+	UINT64 s1 = pState->s[1];
+	UINT64 r = s0 + s1;
+
+	s1 ^= s0;
+	pState->s[0] = ((s0 << 24) | (s0 >> 40)) ^ s1 ^ (s1 << 16);
+	pState->s[1] = (s1 << 37) | (s1 >> 27);
+
+	return r;
+}
+
+void rand_range_r(UINT8 * ptr, UINT32 size, RAND_STATE * pState)
+{
+	UINT64 r;
+
+	while (size >= sizeof(r))
+	{
+		r = rand_next(pState);
+		memcpy(ptr, &r, sizeof(r));
+		ptr += sizeof(r);
+		size -= sizeof(r);
+	}
+
+	if (size)
+	{
+		r = rand_next(pState);
+		memcpy(ptr, &r, size);
+	}
+}
+
 void rand_range(UINT8 * ptr, UINT32 size)
 {
-	UINT32 i;
-	for (i = 0; i < size; i++)
-		ptr[i] = rand();
+	rand_range_r(ptr, size, &libRand);
+}
+
+static volatile UINT8 rand_bench_sink;
+
+/*
+ * Compare libc rand() per byte with rand_range_r() on MMS, MANAGE and HCB
+ * sized buffers, each fill runs for half a second
+ */
+void rand_bench(void)
+{
+	static const UINT32 sizes[] = {300, 1000, 1500};
+	RAND_STATE state;
+	UINT8 * buf;
+	UINT32 i, j, loops[2];
+	ULONG start, ticks = sysClkRateGet() / 2;
+	int k;
+
+	buf = malloc(1500);
+	if (buf == NULL)
+		return;
+
+	rand_state_init(&state, RAND_STREAM_BENCH);
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		for (k = 0; k < 2; k++)
+		{
+			loops[k] = 0;
+			start = tickGet();
+			while (tickGet() - start < ticks)
+			{
+				if (k == 0)
+				{
+					for (j = 0; j < sizes[i]; j++)
+						buf[j] = rand();
+				}
+				else
+					rand_range_r(buf, sizes[i], &state);
+				rand_bench_sink ^= buf[sizes[i] - 1];
+				loops[k]++;
+			}
+		}
+
+		/* loops ran for half a second */
+		printf("%4u bytes : rand() %6u KB/s, rand_range_r() %6u KB/s\n",
+				sizes[i],
+				(UINT32)((UINT64)loops[0] * 2 * sizes[i] / 1000),
+				(UINT32)((UINT64)loops[1] * 2 * sizes[i] / 1000));
+	}
+
+	free(buf);
 }
 
-void moduleReg(void (*start)(void), void (*show)(char *))
+void moduleReg(void (*start)(void), void (*show)(REPORT *))
 {
 	struct testModule * p;
 
@@ -389,20 +519,175 @@ void lib_start()
 	}
 }
 
-void lib_show(char * buf)
+void report_init(REPORT * pRep, char * buf, UINT32 size)
+{
+	assert(pRep != NULL);
+	assert(buf != NULL);
+	assert(size > 0);
+
+	pRep->buf = buf;
+	pRep->size = size;
+	pRep->len = 0;
+	pRep->truncated = FALSE;
+	buf[0] = '\0';
+}
+
+void report_printf(REPORT * pRep, const char * fmt, ...)
+{
+	UINT32 room = pRep->size - pRep->len;
+	va_list ap;
+	int n;
+
+	if (pRep->truncated)
+		return;
+
+	va_start(ap, fmt);
+	n = vsnprintf(pRep->buf + pRep->len, room, fmt, ap);
+	va_end(ap);
+
+	if (n < 0)
+		return;
+
+	if ((UINT32)n >= room)
+	{
+		/* vsnprintf kept what fits and terminated it */
+		pRep->len = pRep->size - 1;
+		pRep->truncated = TRUE;
+	}
+	else
+		pRep->len += n;
+}
+
+#define REPORT_TRUNC_MARK	"\n... report truncated ...\n"
+
+void lib_show(REPORT * pRep)
 {
 	struct testModule * p = (struct testModule *)lstFirst(pModules);
 	struct timeval tv;
 
 	gettimeofday(&tv, NULL);
 
-	sprintf(buf, "\n%s\n", ctime((const time_t *)&tv.tv_sec));
+	report_printf(pRep, "\n%s\n", ctime((const time_t *)&tv.tv_sec));
 
 	while (p != NULL)
 	{
-		p->show(buf + strlen(buf));
+		p->show(pRep);
 		p = (struct testModule *)lstNext((NODE *)p);
 	}
+
+	/* Let the reader know the tail is missing */
+	if (pRep->truncated && (pRep->size > sizeof(REPORT_TRUNC_MARK)))
+		strcpy(pRep->buf + pRep->size - sizeof(REPORT_TRUNC_MARK),
+				REPORT_TRUNC_MARK);
+}
+
+typedef struct report_field
+{
+	const char * str;
+	UINT32 len;
+} REPORT_FIELD;
+
+/*
+ * Time lib_show() and then replay the fields of the report it produced,
+ * once appended with sprintf(buf + strlen(buf)) like the show functions
+ * used to and once through report_printf()
+ */
+int report_bench(UINT32 loops)
+{
+	char * src, * buf, * p;
+	REPORT_FIELD * pFields = NULL;
+	UINT32 i, n, fields = 0, legacy = 0, linear = 0;
+	ULONG start, ticks;
+	REPORT rep;
+	int ret = 0;
+
+	if (loops == 0)
+		loops = 10;
+
+	src = malloc(PRINT_BUF_SIZE);
+	buf = malloc(PRINT_BUF_SIZE);
+	if ((src == NULL) || (buf == NULL))
+	{
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	/* Full report, including device access done by the show functions */
+	start = tickGet();
+	for (i = 0; i < loops; i++)
+	{
+		report_init(&rep, src, PRINT_BUF_SIZE);
+		lib_show(&rep);
+	}
+	ticks = tickGet() - start;
+	printf("lib_show : %u bytes, %u ms per report%s\n", rep.len,
+			(UINT32)((UINT64)ticks * 1000 / sysClkRateGet() / loops),
+			rep.truncated ? " (truncated)" : "");
+
+	/* Split the report into the tab or newline ended fields it was built of */
+	for (p = src; *p; p++)
+	{
+		if ((*p == '\t') || (*p == '\n'))
+			fields++;
+	}
+	fields++;
+	pFields = malloc(fields * sizeof(*pFields));
+	if (pFields == NULL)
+	{
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	n = 0;
+	pFields[0].str = src;
+	for (p = src; *p; p++)
+	{
+		if ((*p == '\t') || (*p == '\n'))
+		{
+			pFields[n].len = p + 1 - pFields[n].str;
+			pFields[++n].str = p + 1;
+		}
+	}
+	pFields[n].len = p - pFields[n].str;
+	fields = n + 1;
+
+	ticks = sysClkRateGet();
+
+	start = tickGet();
+	while (tickGet() - start < ticks)
+	{
+		buf[0] = '\0';
+		for (i = 0; i < fields; i++)
+			sprintf(buf + strlen(buf), "%.*s", (int)pFields[i].len,
+					pFields[i].str);
+		legacy++;
+	}
+	if (strcmp(buf, src))
+		ret = -EFAULT;
+
+	start = tickGet();
+	while (tickGet() - start < ticks)
+	{
+		report_init(&rep, buf, PRINT_BUF_SIZE);
+		for (i = 0; i < fields; i++)
+			report_printf(&rep, "%.*s", (int)pFields[i].len,
+					pFields[i].str);
+		linear++;
+	}
+	if (strcmp(buf, src))
+		ret = -EFAULT;
+
+	printf("%u fields : strlen append %u reports/s, report writer %u reports/s%s\n",
+			fields, legacy, linear, ret ? ", MISMATCH" : "");
+
+exit:
+	if (pFields)
+		free(pFields);
+	if (src)
+		free(src);
+	if (buf)
+		free(buf);
+	return ret;
 }
 
 int is_cpu(void)
@@ -420,10 +705,16 @@ int is_hmi(void)
 	return !is_cpu();
 }
 
-void calc_fletcher32(unsigned char *data, unsigned n_bytes,
+/*
+ * Fletcher-32 over native 16 bit words, both sums start at 0xffff and are
+ * kept modulo 65535 with end around carry. Starting non zero they never
+ * fold to 0, so every engine below gives 1 - 65535 for each sum and the
+ * results are bit identical. An odd n_bytes leaves *cksum untouched.
+ */
+static void fletcher32_scalar(const unsigned char *data, unsigned n_bytes,
         unsigned * cksum)
 {
-    unsigned short * d = (unsigned short *)data;
+    const unsigned short * d = (const unsigned short *)data;
     unsigned n_words = n_bytes / 2;
     unsigned sum1 = 0xffff, sum2 = 0xffff;
     unsigned tlen;
@@ -448,6 +739,225 @@ void calc_fletcher32(unsigned char *data, unsigned n_bytes,
     *cksum = sum2 << 16 | sum1;
 }
 
+/*
+ * Multi lane Fletcher-32
+ *
+ * FLETCHER_LANES words are summed per step, lane j taking words j, j + L,
+ * j + 2L, ... with a[j] the sum of its words and b[j] the sum of a[j] after
+ * every step. Word i = tL + j of n = TL words is weighted n - i in sum2, so
+ *
+ *     sum1 = sum(a[j]),  sum2 = L * sum(b[j]) - sum(j * a[j])
+ *
+ * Lanes are reduced every FLETCHER_BLOCK steps, which keeps b[j] within 32
+ * bits. The words left over are added one by one. The inner loop is plain
+ * C the compiler turns into SIMD where the target has it (SSE2 on the
+ * host, AltiVec with -maltivec), elsewhere the lanes still run as
+ * independent chains. Short buffers do not pay for the fold and go scalar.
+ */
+#define FLETCHER_LANES  8
+#define FLETCHER_BLOCK  256
+#define FLETCHER_MIN    128         /* bytes, shorter ones go scalar */
+
+/* Fold the lanes into the sums of the n words before them */
+static void fletcher32_lanes_fold(const UINT32 * a, const UINT32 * b,
+        UINT64 * pSum1, UINT64 * pSum2)
+{
+    UINT64 sum1 = 0, sumB = 0, sumJ = 0;
+    int j;
+
+    for (j = 0; j < FLETCHER_LANES; j++)
+    {
+        sum1 += a[j];
+        sumB += b[j];
+        sumJ += (UINT64)j * a[j];
+    }
+
+    /* sumJ < L * sum1, so it is taken off a multiple of 65535 above it */
+    *pSum1 = sum1 % 65535;
+    *pSum2 = (FLETCHER_LANES * (sumB % 65535) + FLETCHER_LANES * 65535 -
+            sumJ % 65535) % 65535;
+}
+
+/* Append the left over words and pack the sums like the scalar engine */
+static void fletcher32_finish(const unsigned short * d, unsigned n_words,
+        UINT64 sum1, UINT64 sum2, unsigned * cksum)
+{
+    while (n_words--)
+    {
+        sum1 += *d++;
+        sum2 += sum1;
+    }
+    sum1 %= 65535;
+    sum2 %= 65535;
+
+    *cksum = (sum2 ? sum2 : 0xffff) << 16 | (sum1 ? sum1 : 0xffff);
+}
+
+static void fletcher32_lanes(const unsigned char *data, unsigned n_bytes,
+        unsigned * cksum)
+{
+    const unsigned short * d = (const unsigned short *)data;
+    unsigned steps = n_bytes / 2 / FLETCHER_LANES;
+    UINT32 a[FLETCHER_LANES] = {0}, b[FLETCHER_LANES] = {0};
+    UINT64 sum1, sum2;
+    unsigned t, tlen;
+    int j;
+
+    if (n_bytes < FLETCHER_MIN)
+    {
+        fletcher32_scalar(data, n_bytes, cksum);
+        return;
+    }
+    if (n_bytes % 2)
+        return;
+
+    for (t = 0; t < steps; t += tlen)
+    {
+        tlen = steps - t >= FLETCHER_BLOCK ? FLETCHER_BLOCK : steps - t;
+        for (; tlen; tlen--, d += FLETCHER_LANES)
+        {
+            for (j = 0; j < FLETCHER_LANES; j++)
+            {
+                a[j] += d[j];
+                b[j] += a[j];
+            }
+        }
+        tlen = FLETCHER_BLOCK;
+        for (j = 0; j < FLETCHER_LANES; j++)
+        {
+            a[j] %= 65535;
+            b[j] %= 65535;
+        }
+    }
+
+    fletcher32_lanes_fold(a, b, &sum1, &sum2);
+    fletcher32_finish(d, n_bytes / 2 % FLETCHER_LANES, sum1, sum2, cksum);
+}
+
+typedef struct fletcher_engine
+{
+    const char * name;
+    void (*calc)(const unsigned char *data, unsigned n_bytes, unsigned * cksum);
+} FLETCHER_ENGINE_S;
+
+static const FLETCHER_ENGINE_S fletcher_engines[] =
+{
+    {"scalar",  fletcher32_scalar},
+    {"lanes",   fletcher32_lanes},
+};
+
+#define FLETCHER_ENGINE_CNT (sizeof(fletcher_engines) / sizeof(fletcher_engines[0]))
+
+static const FLETCHER_ENGINE_S * pFletcherEngine = &fletcher_engines[1];
+
+void calc_fletcher32(unsigned char *data, unsigned n_bytes,
+        unsigned * cksum)
+{
+    pFletcherEngine->calc(data, n_bytes, cksum);
+}
+
+/*
+ * Select the engine of calc_fletcher32(), could be called from shell at any
+ * time, e.g. fletcher_engine_set("scalar")
+ */
+int fletcher_engine_set(const char * name)
+{
+    UINT32 i;
+
+    if (name == NULL)
+        return -EINVAL;
+
+    for (i = 0; i < FLETCHER_ENGINE_CNT; i++)
+    {
+        if (strcmp(fletcher_engines[i].name, name) == 0)
+        {
+            pFletcherEngine = &fletcher_engines[i];
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/*
+ * Benchmark all Fletcher engines on bufLen bytes buffers (1500 by default,
+ * MMS packet). Each engine is first checked against the scalar one over
+ * 100000 random lengths up to bufLen, odd ones included, at random even
+ * offsets, on random data and on all 0xff words that hit the reductions
+ * hardest. Then it runs for one second to report its throughput.
+ */
+static volatile unsigned fletcher_bench_sink;
+
+int fletcher_bench(UINT32 bufLen)
+{
+    unsigned char * buf, * ones;
+    unsigned ref, sum;
+    UINT32 i, n, len, off, loops;
+    ULONG start, ticks;
+    RAND_STATE rand;
+    UINT64 rate;
+    int ret = 0;
+
+    if (bufLen == 0)
+        bufLen = 1500;
+
+    buf = malloc(bufLen + 16);
+    ones = malloc(bufLen + 16);
+    if ((buf == NULL) || (ones == NULL))
+    {
+        free(buf);
+        free(ones);
+        return -ENOMEM;
+    }
+
+    rand_state_init(&rand, RAND_STREAM_BENCH);
+    rand_range_r(buf, bufLen + 16, &rand);
+    memset(ones, 0xff, bufLen + 16);
+
+    for (i = 0; i < FLETCHER_ENGINE_CNT; i++)
+    {
+        const FLETCHER_ENGINE_S * pEngine = &fletcher_engines[i];
+        UINT32 mismatch = 0;
+
+        for (n = 0; n < 100000; n++)
+        {
+            rand_range_r((UINT8 *)&len, sizeof(len), &rand);
+            rand_range_r((UINT8 *)&off, sizeof(off), &rand);
+            len %= bufLen + 1;
+            off = off % 8 * 2;
+
+            /* Odd lengths must leave the result alone */
+            ref = sum = n;
+            fletcher32_scalar((n & 1) ? ones + off : buf + off, len, &ref);
+            pEngine->calc((n & 1) ? ones + off : buf + off, len, &sum);
+            if (sum != ref)
+                mismatch++;
+        }
+
+        loops = 0;
+        ticks = sysClkRateGet();
+        start = tickGet();
+        while (tickGet() - start < ticks)
+        {
+            pEngine->calc(buf, bufLen, &sum);
+            fletcher_bench_sink ^= sum;
+            loops++;
+        }
+
+        /* bytes per second, loops ran for exactly one second */
+        rate = (UINT64)loops * bufLen;
+        printf("%-8s : %4u.%02u MB/s, %s\n", pEngine->name,
+                (UINT32)(rate / 1000000), (UINT32)(rate % 1000000 / 10000),
+                mismatch ? "MISMATCH" : "bit-exact");
+        if (mismatch)
+            ret = -EFAULT;
+    }
+
+    free(buf);
+    free(ones);
+    return ret;
+}
+
 int hsb_remote_reg_config(UINT16 addr, UINT32 regAddr, UINT32 regVal)
 {
     HSB_SEND_HEADER * pHdr;
@@ -585,7 +1095,11 @@ tole(0xb3667a2eL), tole(0xc4614ab8L), tole(0x5d681b02L), tole(0x2a6f2b94L),
 tole(0xb40bbe37L), tole(0xc30c8ea1L), tole(0x5a05df1bL), tole(0x2d02ef8dL)
 };
 
+#if _BYTE_ORDER == _LITTLE_ENDIAN
+#define DO_CRC(x) crc = tab[(crc ^ (x)) & 255] ^ (crc >> 8)
+#else
 #define DO_CRC(x) crc = tab[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#endif
 
 static uint32_t crc32_no_comp(uint32_t crc, const char *buf, uint32_t len)
 {
@@ -625,19 +1139,247 @@ static uint32_t crc32_no_comp(uint32_t crc, const char *buf, uint32_t len)
 }
 #undef DO_CRC
 
+/*
+ * Multi-table (slice-by-N) CRC32 engines
+ *
+ * Same polynomial and byte order handling as crc32_no_comp(), but 4, 8 or 16
+ * bytes are folded per step with one lookup per byte. Tables are generated
+ * once from crc_table[] so they share its in-memory byte order.
+ */
+#define CRC_SLICE_MAX   16
+
+static uint32_t crc_slice_table[CRC_SLICE_MAX][256];
+static BOOL crc_slice_inited = FALSE;
+
+static void crc_slice_init(void)
+{
+    uint32_t crc;
+    int i, j;
+
+    for (i = 0; i < 256; i++)
+    {
+        crc = tole(crc_table[i]);
+        crc_slice_table[0][i] = tole(crc);
+        for (j = 1; j < CRC_SLICE_MAX; j++)
+        {
+            crc = tole(crc_table[crc & 0xFF]) ^ (crc >> 8);
+            crc_slice_table[j][i] = tole(crc);
+        }
+    }
+
+    crc_slice_inited = TRUE;
+}
+
+#if _BYTE_ORDER == _LITTLE_ENDIAN
+#define DO_CRC(x)   crc = t[0][(crc ^ (x)) & 255] ^ (crc >> 8)
+#define DO_CRC4(q, n) (t[(n) + 3][(q) & 255] ^ t[(n) + 2][((q) >> 8) & 255] ^ \
+                     t[(n) + 1][((q) >> 16) & 255] ^ t[(n)][((q) >> 24) & 255])
+#else
+#define DO_CRC(x)   crc = t[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#define DO_CRC4(q, n) (t[(n)][(q) & 255] ^ t[(n) + 1][((q) >> 8) & 255] ^ \
+                     t[(n) + 2][((q) >> 16) & 255] ^ t[(n) + 3][((q) >> 24) & 255])
+#endif
+
+static uint32_t crc32_slice_no_comp(uint32_t crc, const char *buf, uint32_t len,
+        uint32_t slice)
+{
+    const uint32_t (*t)[256] = crc_slice_table;
+    const uint8_t *p = (const uint8_t *)buf;
+    const uint32_t *b;
+    uint32_t rem_len, q;
+
+    crc = cpu_to_le32(crc);
+
+    /* Align it */
+    while (len && ((long)p & 3))
+    {
+        DO_CRC(*p++);
+        len--;
+    }
+
+    rem_len = len % slice;
+    len = len / slice;
+    b = (const uint32_t *)p;
+
+    switch (slice)
+    {
+    case 16:
+        for (; len; --len, b += 4)
+        {
+            q = crc ^ b[0];
+            crc = DO_CRC4(q, 12);
+            q = b[1];
+            crc ^= DO_CRC4(q, 8);
+            q = b[2];
+            crc ^= DO_CRC4(q, 4);
+            q = b[3];
+            crc ^= DO_CRC4(q, 0);
+        }
+        break;
+    case 8:
+        for (; len; --len, b += 2)
+        {
+            q = crc ^ b[0];
+            crc = DO_CRC4(q, 4);
+            q = b[1];
+            crc ^= DO_CRC4(q, 0);
+        }
+        break;
+    default:
+        for (; len; --len, b++)
+        {
+            q = crc ^ b[0];
+            crc = DO_CRC4(q, 0);
+        }
+        break;
+    }
+
+    /* And the last few bytes */
+    p = (const uint8_t *)b;
+    while (rem_len--)
+        DO_CRC(*p++);
+
+    return le32_to_cpu(crc);
+}
+#undef DO_CRC4
+#undef DO_CRC
+
+static uint32_t crc32_slice4_no_comp(uint32_t crc, const char *buf, uint32_t len)
+{
+    return crc32_slice_no_comp(crc, buf, len, 4);
+}
+
+static uint32_t crc32_slice8_no_comp(uint32_t crc, const char *buf, uint32_t len)
+{
+    return crc32_slice_no_comp(crc, buf, len, 8);
+}
+
+static uint32_t crc32_slice16_no_comp(uint32_t crc, const char *buf, uint32_t len)
+{
+    return crc32_slice_no_comp(crc, buf, len, 16);
+}
+
+typedef struct cksum_engine
+{
+    const char * name;
+    uint32_t (*crc)(uint32_t crc, const char *buf, uint32_t len);
+} CKSUM_ENGINE_S;
+
+static const CKSUM_ENGINE_S cksum_engines[] =
+{
+    {"table",   crc32_no_comp},
+    {"slice4",  crc32_slice4_no_comp},
+    {"slice8",  crc32_slice8_no_comp},
+    {"slice16", crc32_slice16_no_comp},
+};
+
+#define CKSUM_ENGINE_CNT    (sizeof(cksum_engines) / sizeof(cksum_engines[0]))
+
+/* slice-by-8 by default, its 8KB of tables still fit in L1 */
+static const CKSUM_ENGINE_S * pCksumEngine = &cksum_engines[2];
+
 static uint32_t crc32 (uint32_t crc, const char *p, uint32_t len)
 {
-    return crc32_no_comp(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
+    if (!crc_slice_inited)
+        crc_slice_init();
+
+    return pCksumEngine->crc(crc ^ 0xffffffffL, p, len) ^ 0xffffffffL;
 }
 
-static void rand_buf(char * buf, unsigned int size)
+/*
+ * Select the CRC engine used by cksum_buf_generate() and cksum_buf_verify(),
+ * could be called from shell at any time, e.g. cksum_engine_set("slice16")
+ */
+int cksum_engine_set(const char * name)
 {
-    unsigned int i;
-    for (i = 0; i < size; i++)
-        buf[i] = rand() % 256;
+    UINT32 i;
+
+    if (name == NULL)
+        return -EINVAL;
+
+    for (i = 0; i < CKSUM_ENGINE_CNT; i++)
+    {
+        if (strcmp(cksum_engines[i].name, name) == 0)
+        {
+            if (!crc_slice_inited)
+                crc_slice_init();
+            pCksumEngine = &cksum_engines[i];
+            return 0;
+        }
+    }
+
+    return -ENOENT;
 }
 
-int cksum_buf_generate(char * buf, uint32_t bufLen)
+/*
+ * Benchmark all CRC engines on bufLen bytes buffers (576 by default, HSB SFP
+ * payload). Each engine is first checked bit-exact against the byte table
+ * implementation over all lengths up to bufLen and all alignments, then run
+ * for one second to report its throughput.
+ */
+static volatile uint32_t cksum_bench_sink;
+
+int cksum_bench(UINT32 bufLen)
+{
+    char * buf;
+    UINT32 i, len, off, loops;
+    ULONG start, ticks;
+    uint32_t crc, ref;
+    UINT64 rate;
+    int ret = 0;
+
+    if (bufLen == 0)
+        bufLen = 24 * 24;
+
+    buf = malloc(bufLen + 8);
+    if (buf == NULL)
+        return -ENOMEM;
+
+    for (i = 0; i < bufLen + 8; i++)
+        buf[i] = rand();
+
+    if (!crc_slice_inited)
+        crc_slice_init();
+
+    for (i = 0; i < CKSUM_ENGINE_CNT; i++)
+    {
+        const CKSUM_ENGINE_S * pEngine = &cksum_engines[i];
+        UINT32 mismatch = 0;
+
+        for (off = 0; off < 8; off++)
+        {
+            for (len = 0; len <= bufLen; len++)
+            {
+                ref = crc32_no_comp(0xffffffff, buf + off, len);
+                crc = pEngine->crc(0xffffffff, buf + off, len);
+                if (crc != ref)
+                    mismatch++;
+            }
+        }
+
+        loops = 0;
+        ticks = sysClkRateGet();
+        start = tickGet();
+        while (tickGet() - start < ticks)
+        {
+            cksum_bench_sink ^= pEngine->crc(0xffffffff, buf, bufLen);
+            loops++;
+        }
+
+        /* bytes per second, loops ran for exactly one second */
+        rate = (UINT64)loops * bufLen;
+        printf("%-8s : %4u.%02u MB/s, %s\n", pEngine->name,
+                (UINT32)(rate / 1000000), (UINT32)(rate % 1000000 / 10000),
+                mismatch ? "MISMATCH" : "bit-exact");
+        if (mismatch)
+            ret = -EFAULT;
+    }
+
+    free(buf);
+    return ret;
+}
+
+int cksum_buf_generate_r(char * buf, uint32_t bufLen, RAND_STATE * pRand)
 {
     uint32_t crc = 0;
     /*
@@ -651,7 +1393,7 @@ int cksum_buf_generate(char * buf, uint32_t bufLen)
     /*
      * Randomize data
      */
-    rand_buf(buf + 4, bufLen - 4);
+    rand_range_r((UINT8 *)buf + 4, bufLen - 4, pRand);
 
     /*
      * Generate cksum
@@ -666,6 +1408,11 @@ int cksum_buf_generate(char * buf, uint32_t bufLen)
     return 0;
 }
 
+int cksum_buf_generate(char * buf, uint32_t bufLen)
+{
+    return cksum_buf_generate_r(buf, bufLen, &libRand);
+}
+
 int cksum_buf_verify(char * buf, uint32_t bufLen)
 {
     uint32_t crc = 0;
@@ -694,8 +1441,17 @@ int cksum_buf_verify(char * buf, uint32_t bufLen)
         return -EFAULT;
 }
 
+/*
+ * CRC32 with the selected engine, crc is the value returned by a previous
+ * call over the preceding bytes, or 0 to start
+ */
+uint32_t cksum_calc(uint32_t crc, const char * buf, uint32_t len)
+{
+    return crc32(crc, buf, len);
+}
+
 
-static void timer_hook_give_sem(int arg)
+static void timer_hook_give_sem(_Vx_usr_arg_t arg)
 {
     SEM_ID giveSem = (SEM_ID)arg;
     assert(giveSem != NULL);
@@ -717,7 +1473,7 @@ int timer_set(uint32_t freq, SEM_ID giveSem)
     ret = TimerFreqSet(fd, freq);
     if (ret)
         goto fail;
-    ret = TimerISRSet(fd, timer_hook_give_sem, (int)giveSem);
+    ret = TimerISRSet(fd, timer_hook_give_sem, (_Vx_usr_arg_t)giveSem);
     if (ret)
         goto fail;
     ret = TimerEnable(fd);
@@ -730,7 +1486,236 @@ fail:
     return ret;
 }
 
-void eth_srcmac_fill(INT32 hdr, UINT8 * pkt)
+/*
+ * Create a snapshot of size bytes, stat_snap_update() publishes at most once
+ * every period ticks. NULL if out of memory.
+ */
+STAT_SNAP * stat_snap_create(UINT32 size, UINT32 period)
+{
+    STAT_SNAP * pSnap;
+
+    pSnap = malloc(sizeof(*pSnap));
+    if (pSnap == NULL)
+        return NULL;
+    memset(pSnap, 0, sizeof(*pSnap));
+
+    pSnap->size = size;
+    pSnap->period = period;
+
+    pSnap->buf[0] = malloc(size);
+    pSnap->buf[1] = malloc(size);
+    if ((pSnap->buf[0] == NULL) || (pSnap->buf[1] == NULL))
+    {
+        stat_snap_destroy(pSnap);
+        return NULL;
+    }
+
+    return pSnap;
+}
+
+/* Free a snapshot nobody publishes to or reads any more */
+void stat_snap_destroy(STAT_SNAP * pSnap)
+{
+    if (pSnap == NULL)
+        return;
+    free(pSnap->buf[0]);
+    free(pSnap->buf[1]);
+    free(pSnap);
+}
+
+/*
+ * Publish number n goes into buf[n & 1], so the copy a reader works on is
+ * only overwritten if two more publishes start before it finishes. Only the
+ * task owning the counters may publish.
+ */
+void stat_snap_publish(STAT_SNAP * pSnap, const void * src)
+{
+    UINT32 seq = pSnap->seq;
+    UINT32 next = (seq >> 1) + 1;
+
+    pSnap->seq = seq + 1;
+    VX_MEM_BARRIER_W();
+    memcpy(pSnap->buf[next & 1], src, pSnap->size);
+    VX_MEM_BARRIER_W();
+    pSnap->seq = next << 1;
+    pSnap->lastTick = tickGet();
+}
+
+/*
+ * Publish if the period has elapsed, cheap enough to call from the hot loop
+ */
+BOOL stat_snap_due(STAT_SNAP * pSnap)
+{
+    return (tickGet() - pSnap->lastTick >= pSnap->period);
+}
+
+void stat_snap_update(STAT_SNAP * pSnap, const void * src)
+{
+    if (stat_snap_due(pSnap))
+        stat_snap_publish(pSnap, src);
+}
+
+/*
+ * Copy the last complete publish into dst, never blocks the writer
+ */
+int stat_snap_read(STAT_SNAP * pSnap, void * dst)
+{
+    UINT32 seq, done;
+
+    FOREVER
+    {
+        seq = pSnap->seq;
+        VX_MEM_BARRIER_R();
+
+        done = seq >> 1;
+        if (done == 0)
+            return -EAGAIN;
+
+        memcpy(dst, pSnap->buf[done & 1], pSnap->size);
+        VX_MEM_BARRIER_R();
+
+        /* buf[done & 1] is rewritten from seq (done + 1) * 2 + 1 on */
+        if (pSnap->seq - (done << 1) <= 2)
+            return 0;
+
+        pSnap->retry++;
+    }
+}
+
+#define STAT_SNAP_TEST_WORDS    1024
+
+static volatile BOOL snapTestStop;
+
+static int stat_snap_test_writer(STAT_SNAP * pSnap)
+{
+    UINT32 * pWords;
+    UINT32 i, n = 0;
+    ULONG tick;
+
+    pWords = malloc(STAT_SNAP_TEST_WORDS * sizeof(*pWords));
+    assert(pWords != NULL);
+
+    while (!snapTestStop)
+    {
+        /*
+         * Publish as fast as possible for a whole tick, then leave the next
+         * tick to the reader so it is preempted in the middle of its copies
+         * on a single core as well
+         */
+        tick = tickGet();
+        while (tickGet() == tick)
+        {
+            n++;
+            for (i = 0; i < STAT_SNAP_TEST_WORDS; i++)
+                pWords[i] = n;
+            stat_snap_publish(pSnap, pWords);
+        }
+        taskDelay(1);
+    }
+
+    free(pWords);
+    snapTestStop = FALSE;
+    return 0;
+}
+
+/*
+ * Run a full rate writer against a reader for some seconds, every word of a
+ * publish holds the same value so a torn read shows up as a mismatch. The
+ * writer runs one priority above the caller so it preempts the reader in the
+ * middle of its copies on a single core, and leaves every other tick to it.
+ * Fails unless both sides made progress.
+ */
+int stat_snap_test(UINT32 seconds)
+{
+    STAT_SNAP * pSnap;
+    UINT32 * pWords;
+    UINT32 i, last = 0, reads = 0, torn = 0, backward = 0, publishes;
+    ULONG start;
+    int priority;
+
+    if (seconds == 0)
+        seconds = 10;
+
+    if (taskPriorityGet(taskIdSelf(), &priority) != OK)
+        return -EINVAL;
+    if (priority > 0)
+        priority--;
+
+    pSnap = stat_snap_create(STAT_SNAP_TEST_WORDS * sizeof(*pWords), 0);
+    if (pSnap == NULL)
+        return -ENOMEM;
+    pWords = malloc(STAT_SNAP_TEST_WORDS * sizeof(*pWords));
+    if (pWords == NULL)
+    {
+        stat_snap_destroy(pSnap);
+        return -ENOMEM;
+    }
+
+    snapTestStop = FALSE;
+    if (taskSpawn("tSnapTest", priority, 0, 0x4000, stat_snap_test_writer,
+            (_Vx_usr_arg_t)pSnap, 0,0,0,0,0,0,0,0,0) == TASK_ID_ERROR)
+    {
+        free(pWords);
+        stat_snap_destroy(pSnap);
+        return -EAGAIN;
+    }
+
+    start = tickGet();
+    while (tickGet() - start < seconds * sysClkRateGet())
+    {
+        if (stat_snap_read(pSnap, pWords))
+        {
+            /* Nothing published yet, let the writer in */
+            taskDelay(1);
+            continue;
+        }
+        reads++;
+        for (i = 1; i < STAT_SNAP_TEST_WORDS; i++)
+        {
+            if (pWords[i] != pWords[0])
+            {
+                torn++;
+                break;
+            }
+        }
+        if (pWords[0] < last)
+            backward++;
+        last = pWords[0];
+    }
+
+    /* Wait for the writer to go */
+    snapTestStop = TRUE;
+    while (snapTestStop)
+        taskDelay(1);
+
+    publishes = pSnap->seq >> 1;
+    printf("snapshot test : %u publishes, %u reads, %u retries, %u torn, %u backward\n",
+            publishes, reads, pSnap->retry, torn, backward);
+
+    free(pWords);
+    stat_snap_destroy(pSnap);
+
+    if ((publishes == 0) || (reads == 0))
+        return -EAGAIN;
+    return (torn || backward) ? -EFAULT : 0;
+}
+
+/*
+ * Source MAC of every Ethernet handle, parsed from the driver string once.
+ * ethdev_get() drops the entry of the handle it hands out, so a handle
+ * reused for another device never sends with the old MAC.
+ */
+#define ETH_MAC_CACHE_SIZE  64
+
+typedef struct eth_mac_cache
+{
+    BOOL    valid;
+    UINT8   mac[6];
+} ETH_MAC_CACHE_S;
+
+static ETH_MAC_CACHE_S ethMacCache[ETH_MAC_CACHE_SIZE];
+
+static void eth_srcmac_parse(INT32 hdr, UINT8 * mac)
 {
     UINT32 mac32[6];
     char strMAC[20] = {0};
@@ -741,5 +1726,235 @@ void eth_srcmac_fill(INT32 hdr, UINT8 * pkt)
             mac32 + 4, mac32 + 5);
 
     for (i = 0; i < 6; i++)
-        pkt[6+i] = mac32[i];
+        mac[i] = mac32[i];
+}
+
+/* Forget the MAC of hdr, -1 forgets all after a MAC change */
+void eth_srcmac_invalidate(INT32 hdr)
+{
+    if (hdr < 0)
+        memset(ethMacCache, 0, sizeof(ethMacCache));
+    else if (hdr < ETH_MAC_CACHE_SIZE)
+        ethMacCache[hdr].valid = FALSE;
+}
+
+void eth_srcmac_fill(INT32 hdr, UINT8 * pkt)
+{
+    ETH_MAC_CACHE_S * pEntry;
+
+    if ((hdr < 0) || (hdr >= ETH_MAC_CACHE_SIZE))
+    {
+        eth_srcmac_parse(hdr, pkt + 6);
+        return;
+    }
+
+    pEntry = &ethMacCache[hdr];
+    if (!pEntry->valid)
+    {
+        eth_srcmac_parse(hdr, pEntry->mac);
+        VX_MEM_BARRIER_W();
+        pEntry->valid = TRUE;
+    }
+    memcpy(pkt + 6, pEntry->mac, 6);
+}
+
+/*
+ * Time the source MAC of a frame header of device name ("manage" by
+ * default) parsed from the driver and taken from the cache
+ */
+int eth_srcmac_bench(const char * name)
+{
+    UINT8 pkt[14];
+    UINT64 start, parse, cached;
+    INT32 hdr;
+    UINT32 i, loops = 10000;
+
+    hdr = ethdev_get(name ? name : "manage");
+    if (hdr < 0)
+        return hdr;
+
+    start = timebase_get();
+    for (i = 0; i < loops; i++)
+        eth_srcmac_parse(hdr, pkt + 6);
+    parse = timebase_get() - start;
+
+    start = timebase_get();
+    for (i = 0; i < loops; i++)
+        eth_srcmac_fill(hdr, pkt);
+    cached = timebase_get() - start;
+
+    parse = timebase_to_ns(parse) * 10 / loops;
+    cached = timebase_to_ns(cached) * 10 / loops;
+    printf("parse  : %6u.%u ns/frame\ncached : %6u.%u ns/frame\n",
+            (UINT32)(parse / 10), (UINT32)(parse % 10),
+            (UINT32)(cached / 10), (UINT32)(cached % 10));
+    return DeviceRelease(hdr);
+}
+
+UINT64 timebase_get(void)
+{
+    UINT32 tbu, tbl;
+
+    vxTimeBaseGet(&tbu, &tbl);
+    return ((UINT64)tbu << 32) | tbl;
+}
+
+/*
+ * Time base ticks per second, calibrated against the system clock on the
+ * first call. Set it from shell to skip the calibration.
+ */
+UINT32 timeBaseFreq = 0;
+
+UINT32 timebase_freq(void)
+{
+    UINT32 ticks = sysClkRateGet() / 10;
+    ULONG tick;
+    UINT64 tb;
+
+    if (timeBaseFreq)
+        return timeBaseFreq;
+
+    if (ticks == 0)
+        ticks = 1;
+
+    /* Both ends right after a tick edge */
+    taskDelay(1);
+    tick = tickGet();
+    tb = timebase_get();
+    taskDelay(ticks);
+    tb = timebase_get() - tb;
+    tick = tickGet() - tick;
+
+    timeBaseFreq = tb * sysClkRateGet() / (tick ? tick : 1);
+    return timeBaseFreq;
+}
+
+UINT64 timebase_to_ns(UINT64 ticks)
+{
+    UINT32 freq = timebase_freq();
+
+    /* Split to keep ticks * 1e9 within 64 bits */
+    return (ticks / freq) * 1000000000ULL +
+            (ticks % freq) * 1000000000ULL / freq;
+}
+
+static UINT32 lat_hist_index(UINT32 v)
+{
+    UINT32 msb;
+
+    if (v < LAT_HIST_SUB)
+        return v;
+
+    msb = 31 - __builtin_clz(v);
+    return ((msb - LAT_HIST_SUB_BITS + 1) << LAT_HIST_SUB_BITS) +
+            ((v >> (msb - LAT_HIST_SUB_BITS)) & (LAT_HIST_SUB - 1));
+}
+
+/* Largest value falling in bucket idx */
+static UINT32 lat_hist_upper(UINT32 idx)
+{
+    UINT32 e = idx >> LAT_HIST_SUB_BITS;
+
+    if (e == 0)
+        return idx;
+
+    return (((UINT64)(LAT_HIST_SUB + (idx & (LAT_HIST_SUB - 1))) + 1) << (e - 1)) - 1;
+}
+
+/* A zeroed LAT_HIST is empty */
+void lat_hist_add(LAT_HIST * pHist, UINT64 ticks)
+{
+    UINT32 v = (ticks > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (UINT32)ticks;
+
+    if ((pHist->count == 0) || (v < pHist->min))
+        pHist->min = v;
+    if (v > pHist->max)
+        pHist->max = v;
+    pHist->count++;
+    pHist->bucket[lat_hist_index(v)]++;
+}
+
+/* Value at quantile perTenThousand / 10000, in ticks */
+UINT32 lat_hist_quantile(const LAT_HIST * pHist, UINT32 perTenThousand)
+{
+    UINT64 rank;
+    UINT32 i, seen = 0, v;
+
+    if (pHist->count == 0)
+        return 0;
+
+    rank = ((UINT64)pHist->count * perTenThousand + 9999) / 10000;
+    if (rank == 0)
+        rank = 1;
+
+    for (i = 0; i < LAT_HIST_BUCKETS; i++)
+    {
+        seen += pHist->bucket[i];
+        if (seen >= rank)
+            break;
+    }
+
+    v = lat_hist_upper(i < LAT_HIST_BUCKETS ? i : LAT_HIST_BUCKETS - 1);
+    if (v > pHist->max)
+        v = pHist->max;
+    if (v < pHist->min)
+        v = pHist->min;
+
+    return v;
+}
+
+static void lat_hist_print_us(REPORT * pRep, UINT32 ticks)
+{
+    UINT64 ns = timebase_to_ns(ticks);
+
+    report_printf(pRep, "%8u.%03u", (UINT32)(ns / 1000), (UINT32)(ns % 1000));
+}
+
+/* count, min, p50, p99, p99.9 and max in us, the caller ends the line */
+void lat_hist_print(REPORT * pRep, const char * name, const LAT_HIST * pHist)
+{
+    report_printf(pRep, "%8s\t%10u", name, pHist->count);
+    lat_hist_print_us(pRep, pHist->min);
+    lat_hist_print_us(pRep, lat_hist_quantile(pHist, 5000));
+    lat_hist_print_us(pRep, lat_hist_quantile(pHist, 9900));
+    lat_hist_print_us(pRep, lat_hist_quantile(pHist, 9990));
+    lat_hist_print_us(pRep, pHist->max);
+}
+
+/*
+ * Account seq received on a stream. SEQ_NEW reports in *pGap the numbers
+ * skipped before it, SEQ_LATE a number skipped before, or one too old to
+ * tell, and SEQ_DUP one received before within the window.
+ */
+int seq_win_check(SEQ_WIN * pWin, UINT32 seq, UINT32 * pGap)
+{
+    UINT32 ahead = seq - pWin->expect;
+    UINT32 behind = pWin->expect - 1 - seq;
+
+    *pGap = 0;
+
+    if (!pWin->synced)
+    {
+        /* The first number, the sender may have started long ago */
+        pWin->synced = TRUE;
+        pWin->expect = seq + 1;
+        pWin->mask = 1;
+        return SEQ_NEW;
+    }
+
+    if (ahead < 0x80000000)
+    {
+        *pGap = ahead;
+        pWin->mask = (ahead + 1 < SEQ_WIN_SIZE) ? (pWin->mask << (ahead + 1)) | 1 : 1;
+        pWin->expect = seq + 1;
+        return SEQ_NEW;
+    }
+
+    if (behind >= SEQ_WIN_SIZE)
+        return SEQ_LATE;
+    if (pWin->mask & (1ULL << behind))
+        return SEQ_DUP;
+
+    pWin->mask |= 1ULL << behind;
+    return SEQ_LATE;
 }
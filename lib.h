@@ -2,6 +2,7 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 #include <semLib.h>
@@ -11,6 +12,8 @@
 #include <errnoLib.h>
 #include <isrDeferLib.h>
 #include <jobQueueLib.h>
+#include <tickLib.h>
+#include <vxAtomicLib.h>
 
 #include <arch/ppc/vxPpcLib.h>
 
@@ -19,6 +22,12 @@
 
 #define PRINT_BUF_SIZE  0x40000
 
+/* FPGA register access, a host build maps these onto its simulated FPGA */
+#ifndef FPGA_REG_READ
+#define FPGA_REG_READ(addr)         (*(volatile UINT32 *)(addr))
+#define FPGA_REG_WRITE(addr, val)   (*(volatile UINT32 *)(addr) = (val))
+#endif
+
 typedef struct hsb_recv_hdr
 {
     UINT8   dstMac[6];
@@ -61,15 +70,136 @@ typedef struct hsb_send_hdr
     } u;
 }__attribute((packed)) HSB_SEND_HEADER;
 
+/* Pseudo random stream, one per task */
+typedef struct rand_state
+{
+    UINT64  s[2];
+} RAND_STATE;
+
+/* Random stream IDs, keep them stable so a seed replays the same data */
+enum
+{
+    RAND_STREAM_LIB = 0,
+    RAND_STREAM_BENCH,
+    RAND_STREAM_HCB,
+    RAND_STREAM_HSB,
+    RAND_STREAM_ETH,
+    RAND_STREAM_MANAGE,
+};
+
+/* Big endian loads, safe on any alignment */
+#define BE16_LOAD(p)    ((UINT16)((((const UINT8 *)(p))[0] << 8) | \
+                                  ((const UINT8 *)(p))[1]))
+#define BE32_LOAD(p)    (((UINT32)((const UINT8 *)(p))[0] << 24) | \
+                         ((UINT32)((const UINT8 *)(p))[1] << 16) | \
+                         ((UINT32)((const UINT8 *)(p))[2] << 8)  | \
+                          (UINT32)((const UINT8 *)(p))[3])
+
+/*
+ * Double buffered statistics snapshot
+ *
+ * The task owning the counters publishes a copy, show functions read the
+ * last complete copy without stopping the traffic.
+ */
+typedef struct stat_snap
+{
+    volatile UINT32 seq;    /* twice the publishes done, odd while publishing */
+    UINT32  size;           /* snapshot size in bytes */
+    UINT32  period;         /* ticks between stat_snap_update() publishes */
+    ULONG   lastTick;       /* tick of the last publish */
+    UINT32  retry;          /* reads retried due to a concurrent publish */
+    UINT8 * buf[2];
+} STAT_SNAP;
+
+/* Default snapshot publish period, 100ms */
+#define STAT_SNAP_PERIOD    (sysClkRateGet() / 10)
+
+/*
+ * Bounded report writer handed to the show callbacks. Appending starts at
+ * the cursor, so building a report is linear in its size. Output beyond
+ * size is dropped and flagged as truncated.
+ */
+typedef struct report
+{
+    char *  buf;
+    UINT32  size;
+    UINT32  len;
+    BOOL    truncated;
+} REPORT;
+
+/*
+ * Log-linear latency histogram in time base ticks. Each power of two is split
+ * in LAT_HIST_SUB buckets, so a bucket is at most 12.5% wide. Adding a value
+ * is O(1) integer work, values beyond 32 bits land in the last bucket.
+ */
+#define LAT_HIST_SUB_BITS   3
+#define LAT_HIST_SUB        (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_BUCKETS    ((32 - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB)
+
+typedef struct lat_hist
+{
+    UINT32  count;
+    UINT32  min;
+    UINT32  max;
+    UINT32  bucket[LAT_HIST_BUCKETS];
+} LAT_HIST;
+
+/*
+ * Receive window of a sequence numbered stream, bit i of mask is set once
+ * expect - 1 - i has been received. A zeroed SEQ_WIN takes any first number.
+ */
+#define SEQ_WIN_SIZE        64
+
+typedef struct seq_win
+{
+    BOOL    synced;
+    UINT32  expect;
+    UINT64  mask;
+} SEQ_WIN;
+
+/* seq_win_check() results */
+enum
+{
+    SEQ_NEW,                    /* in order or after a gap */
+    SEQ_LATE,                   /* after a later one, counted in a gap */
+    SEQ_DUP                     /* received before */
+};
+
+/*
+ * How statlog prints the stats struct of module id. swap fixes a copy
+ * written by a board of the other byte order, where the 32 bit words are
+ * right already but 64 bit fields and byte arrays are not, NULL if the
+ * struct is all words.
+ */
+typedef struct statlog_codec
+{
+    UINT32  id;
+    UINT32  size;
+    void    (*format)(REPORT * pRep, const void * pStats);
+    void    (*swap)(void * pStats);
+} STATLOG_CODEC;
+
+/* Modules recorded by the binary statistics log, never renumber */
+enum
+{
+    STATLOG_ID_HCB = 1,
+    STATLOG_ID_HSB,
+    STATLOG_ID_ETH,
+    STATLOG_ID_MANAGE,
+    STATLOG_ID_ION,
+    STATLOG_ID_SV,
+    STATLOG_ID_MAX = 16
+};
+
 /* lib base function called by main module */
 extern void lib_init(void);
 extern void lib_delayed_init(void);
 extern void lib_last_stage_init(void);
 extern void lib_start(void);
-extern void lib_show(char * buf);
+extern void lib_show(REPORT * pRep);
 
 /* Module register */
-extern void moduleReg(void (*start)(void), void (*show)(char *));
+extern void moduleReg(void (*start)(void), void (*show)(REPORT *));
 
 /* Helper functions */
 extern int ethdev_get(const char * name);
@@ -79,6 +209,9 @@ extern int light_get(char * color);
 extern int timer_get(void);
 extern int iondev_get(void);
 extern void rand_range(UINT8 * ptr, UINT32 size);
+extern void rand_range_r(UINT8 * ptr, UINT32 size, RAND_STATE * pState);
+extern void rand_state_init(RAND_STATE * pState, UINT32 stream);
+extern UINT32 randSeed;
 extern int is_cpu(void);
 extern int is_hmi(void);
 extern STATUS queue_add(QJOB * pJob);
@@ -87,9 +220,42 @@ int status_chg_verify(UINT32 status_type, UINT32 status_ret_type, UINT32 assert)
 int hsb_remote_reg_config(UINT16 addr, UINT32 regAddr, UINT32 regVal);
 int hsb_cfg_done(UINT16 addr);
 extern int cksum_buf_generate(char * buf, uint32_t bufLen);
+extern int cksum_buf_generate_r(char * buf, uint32_t bufLen, RAND_STATE * pRand);
 extern int cksum_buf_verify(char * buf, uint32_t bufLen);
+extern int cksum_engine_set(const char * name);
+extern int cksum_bench(UINT32 bufLen);
+extern int fletcher_engine_set(const char * name);
+extern int fletcher_bench(UINT32 bufLen);
 extern int timer_set(uint32_t freq, SEM_ID giveSem);
+extern STAT_SNAP * stat_snap_create(UINT32 size, UINT32 period);
+extern void stat_snap_destroy(STAT_SNAP * pSnap);
+extern void stat_snap_publish(STAT_SNAP * pSnap, const void * src);
+extern void stat_snap_update(STAT_SNAP * pSnap, const void * src);
+extern int stat_snap_read(STAT_SNAP * pSnap, void * dst);
+extern int stat_snap_test(UINT32 seconds);
+extern void report_init(REPORT * pRep, char * buf, UINT32 size);
+extern void report_printf(REPORT * pRep, const char * fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+extern int report_bench(UINT32 loops);
+extern BOOL stat_snap_due(STAT_SNAP * pSnap);
+extern uint32_t cksum_calc(uint32_t crc, const char * buf, uint32_t len);
+extern void statlog_register(UINT32 id, STAT_SNAP * pSnap);
+extern void statlog_swap64(void * p, UINT32 count);
+extern void statlog_swap_bytes(void * p, UINT32 len);
+extern int statlog_append(UINT32 textLen);
+extern int statlog_flush(void);
+extern int statlog_show(const char * path, UINT32 count);
+extern void statlog_info(void);
 extern void eth_srcmac_fill(INT32 hdr, UINT8 * pkt);
+extern void eth_srcmac_invalidate(INT32 hdr);
+extern int eth_srcmac_bench(const char * name);
+extern UINT64 timebase_get(void);
+extern UINT32 timebase_freq(void);
+extern UINT64 timebase_to_ns(UINT64 ticks);
+extern void lat_hist_add(LAT_HIST * pHist, UINT64 ticks);
+extern UINT32 lat_hist_quantile(const LAT_HIST * pHist, UINT32 perTenThousand);
+extern void lat_hist_print(REPORT * pRep, const char * name, const LAT_HIST * pHist);
+extern int seq_win_check(SEQ_WIN * pWin, UINT32 seq, UINT32 * pGap);
 
 /* Module declare */
 #define MODULE_DECLARE(name)	\
@@ -23,23 +23,31 @@ typedef struct manage_status
     SEM_ID          rxSem;          /* rx task control */
     UINT8 *         pkt;            /* Ethernet packet buffer */
     MANAGE_NODE_S   nodes[MANAGE_MAX_NODE];  /* manage node */
+    STAT_SNAP *     pSnap;          /* nodes snapshot */
     INT32           timerFd;        /* Timer Handler */
+    RAND_STATE      rand;           /* Payload random stream */
 }MANAGE_STATUS_S;
 
 static MANAGE_STATUS_S * pStatus = NULL;
 
-static void manage_pkt_gen(int hdr, uint8_t * pkt, unsigned long len, UINT32 idx)
+/* The MAC header is the same for every packet, built once */
+static void manage_hdr_build(int hdr, uint8_t * pkt)
 {
-    assert(pStatus);
-    assert(len >= 60);
-
     /* Broadcast packet */
     memset(pkt, 0xFF, 6);
     eth_srcmac_fill(hdr, pkt);
+}
+
+static void manage_pkt_gen(uint8_t * pkt, unsigned long len, UINT32 idx)
+{
+    assert(pStatus);
+    assert(len >= 60);
+
     /* Fill in index */
     memcpy(pkt + 12, &idx, sizeof(idx));
     /* Fill in data with checksum */
-    assert(cksum_buf_generate((char *)pkt + 12 + sizeof(idx), len - 12 - sizeof(idx)) == 0);
+    assert(cksum_buf_generate_r((char *)pkt + 12 + sizeof(idx), len - 12 - sizeof(idx),
+            &pStatus->rand) == 0);
 }
 
 static int manage_pkt_verify(char * buf, unsigned long len, UINT32 * idx, UINT8 * mac)
@@ -62,7 +70,7 @@ static int manage_send_entry(void)
     {
         semTake(pStatus->txSem, WAIT_FOREVER);
         /* Send one pkt */
-        manage_pkt_gen(pStatus->hdr, pStatus->pkt, MANAGE_PKT_LEN, idx ++);
+        manage_pkt_gen(pStatus->pkt, MANAGE_PKT_LEN, idx ++);
         do
         {
             ret = EthernetSendPkt(pStatus->hdr, pStatus->pkt, MANAGE_PKT_LEN);
@@ -157,6 +165,9 @@ static int manage_recv_entry(void)
             ret = EthernetRecvPoll(pStatus->hdr, &pktlimit);
         }while(ret == -EAGAIN);
 
+        /* Publish nodes for manage_show() */
+        stat_snap_update(pStatus->pSnap, pStatus->nodes);
+
         if (++cnt >= MANAGE_MAX_NODE)
         {
             cnt = 0;
@@ -167,6 +178,41 @@ static int manage_recv_entry(void)
     return 0;
 }
 
+static void manage_stats_format(REPORT * pRep, const void * p)
+{
+    const MANAGE_NODE_S * nodes = p;
+    static uint8_t empty_mac[6] = {0};
+    int i;
+
+    report_printf(pRep, "\n*********** MANAGE ***********\n");
+    for (i = 0; i < MANAGE_MAX_NODE; i++)
+    {
+        const MANAGE_NODE_S * pNode = &nodes[i];
+        if (memcmp(pNode->src_mac, empty_mac, 6) == 0)
+            continue;
+        report_printf(pRep,
+                "%02X:%02X:%02X:%02X:%02X:%02X : Recv %10d; Missing %10d\n",
+                pNode->src_mac[0], pNode->src_mac[1], pNode->src_mac[2],
+                pNode->src_mac[3], pNode->src_mac[4], pNode->src_mac[5],
+                pNode->recved, pNode->missing);
+    }
+}
+
+/* MAC bytes written by a board of the other byte order */
+static void manage_stats_swap(void * p)
+{
+    MANAGE_NODE_S * nodes = p;
+    int i;
+
+    for (i = 0; i < MANAGE_MAX_NODE; i++)
+        statlog_swap_bytes(nodes[i].src_mac, sizeof(nodes[i].src_mac));
+}
+
+const STATLOG_CODEC manageStatlog =
+{
+    STATLOG_ID_MANAGE, sizeof(MANAGE_NODE_S) * MANAGE_MAX_NODE, manage_stats_format, manage_stats_swap
+};
+
 void manage_start(void)
 {
     pStatus = malloc(sizeof(*pStatus));
@@ -176,6 +222,8 @@ void manage_start(void)
     pStatus->pkt = malloc(MANAGE_BUFFER_LEN);
     assert(pStatus->pkt);
 
+    rand_state_init(&pStatus->rand, RAND_STREAM_MANAGE);
+
     pStatus->hdr = ethdev_get(MANAGE_DEV_NAME);
     if(pStatus->hdr < 0)
     {
@@ -183,6 +231,12 @@ void manage_start(void)
        pStatus = NULL;
        return;
     }
+    manage_hdr_build(pStatus->hdr, pStatus->pkt);
+
+    pStatus->pSnap = stat_snap_create(sizeof(pStatus->nodes), STAT_SNAP_PERIOD);
+    assert(pStatus->pSnap);
+    stat_snap_publish(pStatus->pSnap, pStatus->nodes);
+    statlog_register(STATLOG_ID_MANAGE, pStatus->pSnap);
 
     pStatus->txSem = semBCreate(SEM_Q_PRIORITY, SEM_EMPTY);
     assert(pStatus->txSem);
@@ -199,31 +253,14 @@ void manage_start(void)
             1,2,3,4,5,6,7,8,9,10);
 }
 
-static void manage_show(char * buf)
+static void manage_show(REPORT * pRep)
 {
-    int i;
+    MANAGE_NODE_S nodes[MANAGE_MAX_NODE];
 
-    if (!pStatus)
+    if (!pStatus || stat_snap_read(pStatus->pSnap, nodes))
         return;
 
-    TimerDisable(pStatus->timerFd);
-    taskDelay(1);
-
-    snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-            "\n*********** MANAGE ***********\n");
-    for (i = 0; i < MANAGE_MAX_NODE; i++)
-    {
-        MANAGE_NODE_S * pNode = &pStatus->nodes[i];
-        if (is_node_empty(i))
-            continue;
-        snprintf(buf + strlen(buf), PRINT_BUF_SIZE - strlen(buf),
-                "%02X:%02X:%02X:%02X:%02X:%02X : Recv %10d; Missing %10d\n",
-                pNode->src_mac[0], pNode->src_mac[1], pNode->src_mac[2],
-                pNode->src_mac[3], pNode->src_mac[4], pNode->src_mac[5],
-                pNode->recved, pNode->missing);
-    }
-
-    TimerEnable(pStatus->timerFd);
+    manage_stats_format(pRep, nodes);
 }
 
 MODULE_REGISTER(manage)
@@ -0,0 +1,751 @@
+#include "lib.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+
+/*
+ * Binary statistics log
+ *
+ * Every report period the counters snapshot of each registered module is
+ * appended to a fixed size ring file as one frame :
+ *
+ *   0xA5 0x5A | LEN(2) | SEQ(4) | TIME(4) | entries | CRC32(4)
+ *
+ * and each entry is
+ *
+ *   ID | WORDS(varint) | BYTES(varint) | tokens
+ *
+ * The stats struct of a module is encoded as 32 bit words, each one the
+ * difference to the same word of the previous entry of that module. A token
+ * with bit 0 set is a run of (token >> 1) unchanged words, otherwise it is
+ * one zigzag encoded difference. Key entries (ID | STATLOG_KEY) are encoded
+ * against zero and start a new delta chain. Frames never wrap around the end
+ * of the file, the reader finds them by marker and CRC and orders them by
+ * SEQ.
+ *
+ * The file header is MAGIC | VERSION | SIZE | FLAGS, every header and frame
+ * field is big endian. Words are numbers, FLAGS tells the byte order of the
+ * board that wrote them, so a file of any board decodes on any other with
+ * the STATLOG_CODEC of the modules, which does not need them running.
+ */
+
+#ifndef STATLOG_PATH
+#define STATLOG_PATH        "/tffs/stat.bin"
+#endif
+#define STATLOG_MAGIC       0x5446534C      /* "TFSL" */
+#define STATLOG_VERSION     2
+#define STATLOG_FLAG_BE     0x1             /* written by a big endian board */
+#define STATLOG_HDR_SIZE    16
+#define STATLOG_FRAME_HDR   12
+#define STATLOG_KEY         0x80
+#define STATLOG_BUF_SIZE    0x10000
+#define STATLOG_FRAME_MAX   0xFFFF
+
+typedef struct statlog_src
+{
+    STAT_SNAP * pSnap;
+    UINT32      words;
+    UINT32 *    cur;
+    UINT32 *    prev;
+    BOOL        havePrev;
+} STATLOG_SRC;
+
+typedef struct statlog_ref
+{
+    UINT32 off;
+    UINT32 len;
+    UINT32 seq;
+} STATLOG_REF;
+
+typedef struct statlog
+{
+    SEM_ID      lock;
+    INT32       fd;
+    UINT32      ringSize;
+    UINT32      writePos;       /* file offset of buf[0] */
+    UINT32      bufLen;
+    UINT8 *     buf;
+    UINT32      frameMax;       /* worst case frame of all sources */
+    UINT32      seq;
+    ULONG       flushTick;
+    UINT64      textBytes;
+    UINT64      binBytes;
+    UINT32      frames;
+    UINT32      writeFail;
+    STATLOG_SRC src[STATLOG_ID_MAX];
+} STATLOG;
+
+/* Ring file size in bytes, set before test_start() */
+UINT32 statLogSize = 0x80000;
+/* One key entry every statLogKeyframe frames */
+UINT32 statLogKeyframe = 16;
+/* Frames are kept in RAM up to this many seconds */
+UINT32 statLogFlushSec = 300;
+
+static STATLOG * pLog = NULL;
+
+/* Every module statlog knows of, kept by the modules next to their format */
+extern const STATLOG_CODEC canhcbStatlog;
+extern const STATLOG_CODEC hsbStatlog;
+extern const STATLOG_CODEC ethStatlog;
+extern const STATLOG_CODEC manageStatlog;
+extern const STATLOG_CODEC ionStatlog;
+extern const STATLOG_CODEC svStatlog;
+
+static const STATLOG_CODEC * const statlogCodecs[] =
+{
+    &canhcbStatlog,
+    &hsbStatlog,
+    &ethStatlog,
+    &manageStatlog,
+    &ionStatlog,
+    &svStatlog,
+};
+
+static const STATLOG_CODEC * statlog_codec(UINT32 id)
+{
+    UINT32 i;
+
+    for (i = 0; i < sizeof(statlogCodecs) / sizeof(statlogCodecs[0]); i++)
+    {
+        if (statlogCodecs[i]->id == id)
+            return statlogCodecs[i];
+    }
+    return NULL;
+}
+
+static BOOL statlog_big_endian(void)
+{
+    UINT32 one = 1;
+
+    return *(UINT8 *)&one == 0;
+}
+
+static void statlog_be32_put(UINT8 * p, UINT32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* Swap the 32 bit halves of count UINT64, for STATLOG_CODEC swap */
+void statlog_swap64(void * p, UINT32 count)
+{
+    UINT32 * pWord = p, tmp;
+
+    while (count--)
+    {
+        tmp = pWord[0];
+        pWord[0] = pWord[1];
+        pWord[1] = tmp;
+        pWord += 2;
+    }
+}
+
+/* Reverse the bytes of every word of a byte array of len bytes, word aligned */
+void statlog_swap_bytes(void * p, UINT32 len)
+{
+    UINT8 * pByte = p, tmp;
+    UINT32 i;
+
+    for (i = 0; i + 4 <= ((len + 3) & ~3); i += 4)
+    {
+        tmp = pByte[i];
+        pByte[i] = pByte[i + 3];
+        pByte[i + 3] = tmp;
+        tmp = pByte[i + 1];
+        pByte[i + 1] = pByte[i + 2];
+        pByte[i + 2] = tmp;
+    }
+}
+
+static void statlog_create(void)
+{
+    if (pLog)
+        return;
+
+    pLog = malloc(sizeof(*pLog));
+    assert(pLog != NULL);
+    memset(pLog, 0, sizeof(*pLog));
+
+    pLog->lock = semMCreate(SEM_Q_PRIORITY | SEM_INVERSION_SAFE);
+    assert(pLog->lock != NULL);
+
+    pLog->fd = -1;
+    pLog->frameMax = STATLOG_FRAME_HDR + 4;
+}
+
+/*
+ * Called by the modules once their snapshot exists, the snapshot holds the
+ * stats struct of the module's STATLOG_CODEC
+ */
+void statlog_register(UINT32 id, STAT_SNAP * pSnap)
+{
+    const STATLOG_CODEC * pCodec = statlog_codec(id);
+    STATLOG_SRC * pSrc;
+
+    assert((id > 0) && (id < STATLOG_ID_MAX));
+    assert(pSnap != NULL);
+    assert((pCodec != NULL) && (pCodec->size == pSnap->size));
+    assert((pSnap->size % 4) == 0);
+
+    statlog_create();
+    semTake(pLog->lock, WAIT_FOREVER);
+
+    pSrc = &pLog->src[id];
+    assert(pSrc->pSnap == NULL);
+
+    pSrc->pSnap = pSnap;
+    pSrc->words = pSnap->size / 4;
+    pSrc->cur = malloc(pSnap->size);
+    pSrc->prev = malloc(pSnap->size);
+    assert((pSrc->cur != NULL) && (pSrc->prev != NULL));
+    pSrc->havePrev = FALSE;
+
+    /* ID, two varints and at most 5 bytes per word */
+    pLog->frameMax += 1 + 5 + 5 + pSrc->words * 5;
+    assert(pLog->frameMax <= STATLOG_FRAME_MAX);
+
+    semGive(pLog->lock);
+}
+
+static UINT8 * statlog_varint_put(UINT8 * p, UINT64 v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static int statlog_varint_get(const UINT8 ** pp, const UINT8 * end, UINT64 * pV)
+{
+    const UINT8 * p = *pp;
+    UINT64 v = 0;
+    int shift;
+
+    for (shift = 0; (p < end) && (shift < 64); shift += 7)
+    {
+        v |= (UINT64)(*p & 0x7F) << shift;
+        if ((*p++ & 0x80) == 0)
+        {
+            *pp = p;
+            *pV = v;
+            return 0;
+        }
+    }
+
+    return -EFAULT;
+}
+
+static UINT8 * statlog_encode(UINT8 * p, const UINT32 * cur,
+        const UINT32 * prev, UINT32 words)
+{
+    UINT32 i, run = 0;
+    INT32 d;
+
+    for (i = 0; i < words; i++)
+    {
+        d = cur[i] - (prev ? prev[i] : 0);
+        if (d == 0)
+        {
+            run++;
+            continue;
+        }
+        if (run)
+        {
+            p = statlog_varint_put(p, ((UINT64)run << 1) | 1);
+            run = 0;
+        }
+        /* zigzag, small differences of either sign stay small */
+        p = statlog_varint_put(p, (UINT64)(((UINT32)d << 1) ^ (UINT32)(d >> 31)) << 1);
+    }
+
+    /* a trailing run is implied by WORDS */
+    return p;
+}
+
+/*
+ * Apply the tokens in [p, end) to words, which holds the previous values or
+ * zeros for a key entry
+ */
+static int statlog_decode(const UINT8 * p, const UINT8 * end, UINT32 * words,
+        UINT32 count)
+{
+    UINT32 i = 0, z;
+    UINT64 t;
+
+    while (p < end)
+    {
+        if (statlog_varint_get(&p, end, &t))
+            return -EFAULT;
+
+        if (t & 1)
+        {
+            if ((t >> 1) > count - i)
+                return -EFAULT;
+            i += t >> 1;
+        }
+        else
+        {
+            if (i >= count)
+                return -EFAULT;
+            z = t >> 1;
+            words[i++] += (z >> 1) ^ -(z & 1);
+        }
+    }
+
+    return 0;
+}
+
+static int statlog_pwrite(INT32 fd, UINT32 off, const void * buf, UINT32 len)
+{
+    if (lseek(fd, off, SEEK_SET) != (off_t)off)
+        return -EIO;
+    if (write(fd, (char *)buf, len) != (ssize_t)len)
+        return -EIO;
+    return 0;
+}
+
+static int statlog_pread(INT32 fd, UINT32 off, void * buf, UINT32 len)
+{
+    if (lseek(fd, off, SEEK_SET) != (off_t)off)
+        return -EIO;
+    if (read(fd, (char *)buf, len) != (ssize_t)len)
+        return -EIO;
+    return 0;
+}
+
+static int statlog_ref_cmp(const void * a, const void * b)
+{
+    UINT32 sa = ((const STATLOG_REF *)a)->seq;
+    UINT32 sb = ((const STATLOG_REF *)b)->seq;
+
+    return (sa > sb) - (sa < sb);
+}
+
+/*
+ * Collect the valid frames of a ring image ordered by SEQ
+ */
+static STATLOG_REF * statlog_scan(const UINT8 * img, UINT32 size, UINT32 * pCount)
+{
+    STATLOG_REF * pRefs;
+    UINT32 off, len, crc, n = 0;
+
+    /* A frame is at least STATLOG_FRAME_HDR + 4 bytes */
+    pRefs = malloc((size / (STATLOG_FRAME_HDR + 4) + 1) * sizeof(*pRefs));
+    if (pRefs == NULL)
+        return NULL;
+
+    off = STATLOG_HDR_SIZE;
+    while (off + STATLOG_FRAME_HDR + 4 <= size)
+    {
+        if ((img[off] != 0xA5) || (img[off + 1] != 0x5A))
+        {
+            off++;
+            continue;
+        }
+
+        len = BE16_LOAD(img + off + 2);
+        if ((len < STATLOG_FRAME_HDR + 4) || (off + len > size))
+        {
+            off++;
+            continue;
+        }
+
+        crc = BE32_LOAD(img + off + len - 4);
+        if (crc != cksum_calc(0, (const char *)img + off, len - 4))
+        {
+            off++;
+            continue;
+        }
+
+        pRefs[n].off = off;
+        pRefs[n].len = len;
+        pRefs[n].seq = BE32_LOAD(img + off + 4);
+        n++;
+        off += len;
+    }
+
+    qsort(pRefs, n, sizeof(*pRefs), statlog_ref_cmp);
+    *pCount = n;
+    return pRefs;
+}
+
+/* Read the whole ring of a file, pFlags gets the FLAGS of its header */
+static UINT8 * statlog_load(INT32 fd, UINT32 * pSize, UINT32 * pFlags)
+{
+    UINT8 hdr[STATLOG_HDR_SIZE];
+    UINT32 size;
+    UINT8 * img;
+
+    if (statlog_pread(fd, 0, hdr, sizeof(hdr)))
+        return NULL;
+    size = BE32_LOAD(hdr + 8);
+    if ((BE32_LOAD(hdr) != STATLOG_MAGIC) || (BE32_LOAD(hdr + 4) != STATLOG_VERSION) ||
+            (size <= STATLOG_HDR_SIZE))
+        return NULL;
+
+    img = malloc(size);
+    if (img == NULL)
+        return NULL;
+
+    /* The ring may not be fully written yet, a short read is fine */
+    memset(img, 0, size);
+    if ((lseek(fd, 0, SEEK_SET) != 0) ||
+            (read(fd, (char *)img, size) < (ssize_t)STATLOG_HDR_SIZE))
+    {
+        free(img);
+        return NULL;
+    }
+
+    *pSize = size;
+    *pFlags = BE32_LOAD(hdr + 12);
+    return img;
+}
+
+/*
+ * Open the ring file and continue after its newest frame, or start a new one
+ * if it does not match statLogSize
+ */
+static int statlog_open(void)
+{
+    STATLOG_REF * pRefs;
+    UINT32 size, count, flags;
+    UINT8 hdr[STATLOG_HDR_SIZE];
+    UINT8 * img;
+
+    /* Kept across failed opens, statlog_append() retries every time */
+    if (pLog->buf == NULL)
+        pLog->buf = malloc(STATLOG_BUF_SIZE);
+    if (pLog->buf == NULL)
+        return -ENOMEM;
+
+    pLog->fd = open(STATLOG_PATH, O_RDWR | O_CREAT, 0666);
+    if (pLog->fd < 0)
+        return -EIO;
+
+    /* Room for at least one full buffer */
+    pLog->ringSize = statLogSize;
+    if (pLog->ringSize < STATLOG_HDR_SIZE + STATLOG_BUF_SIZE)
+        pLog->ringSize = STATLOG_HDR_SIZE + STATLOG_BUF_SIZE;
+    pLog->writePos = STATLOG_HDR_SIZE;
+    pLog->flushTick = tickGet();
+
+    img = statlog_load(pLog->fd, &size, &flags);
+    if (img && (size == pLog->ringSize) &&
+            (((flags & STATLOG_FLAG_BE) != 0) == statlog_big_endian()))
+    {
+        pRefs = statlog_scan(img, size, &count);
+        if (pRefs && count)
+        {
+            pLog->writePos = pRefs[count - 1].off + pRefs[count - 1].len;
+            pLog->seq = pRefs[count - 1].seq + 1;
+        }
+        if (pRefs)
+            free(pRefs);
+        free(img);
+        return 0;
+    }
+    if (img)
+        free(img);
+
+    /* New ring */
+    close(pLog->fd);
+    pLog->fd = open(STATLOG_PATH, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (pLog->fd < 0)
+        return -EIO;
+
+    statlog_be32_put(hdr, STATLOG_MAGIC);
+    statlog_be32_put(hdr + 4, STATLOG_VERSION);
+    statlog_be32_put(hdr + 8, pLog->ringSize);
+    statlog_be32_put(hdr + 12, statlog_big_endian() ? STATLOG_FLAG_BE : 0);
+    return statlog_pwrite(pLog->fd, 0, hdr, sizeof(hdr));
+}
+
+static int statlog_flush_locked(void)
+{
+    int ret = 0;
+
+    if (pLog->bufLen)
+    {
+        ret = statlog_pwrite(pLog->fd, pLog->writePos, pLog->buf, pLog->bufLen);
+        if (ret)
+            pLog->writeFail++;
+        pLog->writePos += pLog->bufLen;
+        pLog->bufLen = 0;
+    }
+    pLog->flushTick = tickGet();
+
+    return ret;
+}
+
+/*
+ * Write buffered frames to the ring file now
+ */
+int statlog_flush(void)
+{
+    int ret;
+
+    if (!pLog || (pLog->fd < 0))
+        return -ENODEV;
+
+    semTake(pLog->lock, WAIT_FOREVER);
+    ret = statlog_flush_locked();
+    semGive(pLog->lock);
+
+    return ret;
+}
+
+/*
+ * Append one frame with the current snapshot of every registered module,
+ * textLen is the size of the text report the frame stands for
+ */
+int statlog_append(UINT32 textLen)
+{
+    UINT8 * frame, * p, * pBytes;
+    UINT32 id, len, crc, bytes;
+    STATLOG_SRC * pSrc;
+    BOOL key;
+    int ret = 0;
+
+    if (!pLog)
+        return -ENODEV;
+
+    semTake(pLog->lock, WAIT_FOREVER);
+
+    if ((pLog->fd < 0) && (ret = statlog_open()) != 0)
+        goto exit;
+
+    /* Make room for the worst case */
+    if (pLog->bufLen + pLog->frameMax > STATLOG_BUF_SIZE)
+        statlog_flush_locked();
+
+    frame = pLog->buf + pLog->bufLen;
+    p = frame + STATLOG_FRAME_HDR;
+    key = statLogKeyframe ? ((pLog->seq % statLogKeyframe) == 0) : TRUE;
+
+    for (id = 1; id < STATLOG_ID_MAX; id++)
+    {
+        pSrc = &pLog->src[id];
+        if ((pSrc->pSnap == NULL) || stat_snap_read(pSrc->pSnap, pSrc->cur))
+            continue;
+
+        if (key || !pSrc->havePrev)
+            *p++ = id | STATLOG_KEY;
+        else
+            *p++ = id;
+        p = statlog_varint_put(p, pSrc->words);
+
+        /* BYTES is patched once known, reserve the worst case varint */
+        pBytes = p;
+        p += 5;
+        p = statlog_encode(p, pSrc->cur,
+                (key || !pSrc->havePrev) ? NULL : pSrc->prev, pSrc->words);
+        bytes = p - pBytes - 5;
+        len = statlog_varint_put(pBytes, bytes) - pBytes;
+        memmove(pBytes + len, pBytes + 5, bytes);
+        p -= 5 - len;
+
+        memcpy(pSrc->prev, pSrc->cur, pSrc->words * 4);
+        pSrc->havePrev = TRUE;
+    }
+
+    len = p - frame + 4;
+    frame[0] = 0xA5;
+    frame[1] = 0x5A;
+    frame[2] = len >> 8;
+    frame[3] = len;
+    statlog_be32_put(frame + 4, pLog->seq);
+    statlog_be32_put(frame + 8, time(NULL));
+    crc = cksum_calc(0, (const char *)frame, len - 4);
+    statlog_be32_put(p, crc);
+
+    /* Frames never wrap, go back to the start of the ring */
+    if (pLog->writePos + pLog->bufLen + len > pLog->ringSize)
+    {
+        pLog->bufLen = frame - pLog->buf;
+        statlog_flush_locked();
+        memmove(pLog->buf, frame, len);
+        pLog->writePos = STATLOG_HDR_SIZE;
+    }
+    pLog->bufLen += len;
+
+    pLog->seq++;
+    pLog->frames++;
+    pLog->binBytes += len;
+    pLog->textBytes += textLen;
+
+    if (tickGet() - pLog->flushTick >= statLogFlushSec * sysClkRateGet())
+        ret = statlog_flush_locked();
+
+exit:
+    semGive(pLog->lock);
+    return ret;
+}
+
+/*
+ * Decode the ring file back into text reports, only the newest count
+ * frames are printed (all if 0). path defaults to the running log. Needs no
+ * module running, the host statdump tool decodes the files of any board.
+ */
+int statlog_show(const char * path, UINT32 count)
+{
+    STATLOG_REF * pRefs = NULL;
+    UINT32 i, id, size, flags, frames, maxSize = 0, lastSeq = 0;
+    UINT64 words, bytes;
+    const UINT8 * p, * end;
+    const STATLOG_CODEC * pCodec;
+    UINT32 * state[STATLOG_ID_MAX] = {0};
+    BOOL valid[STATLOG_ID_MAX] = {0};
+    BOOL swap;
+    UINT32 * copy = NULL;
+    char * text = NULL;
+    UINT8 * img = NULL;
+    REPORT rep;
+    time_t stamp;
+    INT32 fd;
+    int ret = 0;
+
+    if (path == NULL)
+    {
+        if (!pLog)
+            return -ENODEV;
+        path = STATLOG_PATH;
+        statlog_flush();
+    }
+
+    fd = open(path, O_RDONLY, 0);
+    if (fd < 0)
+        return -ENOENT;
+    img = statlog_load(fd, &size, &flags);
+    close(fd);
+    if (img == NULL)
+        return -EFAULT;
+    swap = (((flags & STATLOG_FLAG_BE) != 0) != statlog_big_endian());
+
+    pRefs = statlog_scan(img, size, &frames);
+    text = malloc(PRINT_BUF_SIZE);
+    if ((pRefs == NULL) || (text == NULL))
+    {
+        ret = -ENOMEM;
+        goto exit;
+    }
+
+    /* Decode state of every module known */
+    for (id = 1; id < STATLOG_ID_MAX; id++)
+    {
+        pCodec = statlog_codec(id);
+        if (pCodec == NULL)
+            continue;
+        state[id] = malloc(pCodec->size);
+        if (state[id] == NULL)
+        {
+            ret = -ENOMEM;
+            goto exit;
+        }
+        if (pCodec->size > maxSize)
+            maxSize = pCodec->size;
+    }
+
+    /* The other byte order is fixed on a copy, state keeps the words */
+    if (swap && ((copy = malloc(maxSize)) == NULL))
+    {
+        ret = -ENOMEM;
+        goto exit;
+    }
+
+    for (i = 0; i < frames; i++)
+    {
+        p = img + pRefs[i].off;
+        end = p + pRefs[i].len - 4;
+
+        /* A gap breaks every delta chain */
+        if (pRefs[i].seq != lastSeq + 1)
+            memset(valid, 0, sizeof(valid));
+        lastSeq = pRefs[i].seq;
+
+        stamp = BE32_LOAD(p + 8);
+        report_init(&rep, text, PRINT_BUF_SIZE);
+        report_printf(&rep, "\n#%u %s", pRefs[i].seq, ctime(&stamp));
+
+        p += STATLOG_FRAME_HDR;
+        while (p < end)
+        {
+            id = *p++;
+            if (statlog_varint_get(&p, end, &words) ||
+                    statlog_varint_get(&p, end, &bytes) ||
+                    (bytes > (UINT64)(end - p)))
+                break;
+
+            pCodec = statlog_codec(id & ~STATLOG_KEY);
+            if ((pCodec == NULL) || (pCodec->size / 4 != words))
+            {
+                /* Not known by this build */
+                p += bytes;
+                continue;
+            }
+
+            if (id & STATLOG_KEY)
+            {
+                id &= ~STATLOG_KEY;
+                memset(state[id], 0, pCodec->size);
+                valid[id] = TRUE;
+            }
+
+            if (valid[id] && statlog_decode(p, p + bytes, state[id], words))
+                valid[id] = FALSE;
+            p += bytes;
+            if (!valid[id])
+                continue;
+
+            if (swap && pCodec->swap)
+            {
+                memcpy(copy, state[id], pCodec->size);
+                pCodec->swap(copy);
+                pCodec->format(&rep, copy);
+            }
+            else
+                pCodec->format(&rep, state[id]);
+        }
+
+        if ((count == 0) || (i + count >= frames))
+            printf("%s", text);
+    }
+
+exit:
+    for (id = 1; id < STATLOG_ID_MAX; id++)
+    {
+        if (state[id])
+            free(state[id]);
+    }
+    if (copy)
+        free(copy);
+    if (pRefs)
+        free(pRefs);
+    if (text)
+        free(text);
+    free(img);
+    return ret;
+}
+
+/*
+ * Bytes written compared to the text reports they replace
+ */
+void statlog_info(void)
+{
+    if (!pLog)
+        return;
+
+    printf("statlog : %u frames, %llu bytes binary, %llu bytes text",
+            pLog->frames, pLog->binBytes, pLog->textBytes);
+    if (pLog->binBytes)
+        printf(", %llu.%01llux smaller",
+                pLog->textBytes / pLog->binBytes,
+                pLog->textBytes * 10 / pLog->binBytes % 10);
+    printf(", seq %u, write offset %u, %u write failures\n",
+            pLog->seq, pLog->writePos + pLog->bufLen, pLog->writeFail);
+}
@@ -1,5 +1,48 @@
 #include "lib.h"
 
+#define PKT_BUF_SIZE	2048		/* SV packet buffer limit */
+#define SV_TIMER_FREQ	2400        /* SV sample rate 1200sps */
+#define SV_RING_SIZE	128			/* frames waiting for the forward task */
+#define SV_FWD_BATCH	16			/* frames sent per forward wakeup */
+
+#define SV_POLLING_TASK_PRIORITY	40
+#define SV_FWD_TASK_PRIORITY		45
+
+/* Counters of the receive hook, published by the polling task */
+typedef struct sv_rx
+{
+	UINT32 recv;					/* frames received from the SV port */
+	UINT32 ringDrop;				/* dropped, the ring was full */
+	UINT32 tooLong;					/* dropped, longer than a slot */
+	UINT32 ringHwm;					/* most frames waiting at once */
+} SV_RX_S;
+
+/*
+ * Counters published to sv_show(). rx is the last snapshot of the polling
+ * task, copied in by the forward task.
+ */
+typedef struct sv_stats
+{
+	SV_RX_S rx;
+	UINT32 forwarded;				/* frames sent out of the debug port */
+	UINT32 sendBusy;				/* debug port busy, batch cut short */
+	UINT32 sendFail;				/* dropped, the send failed */
+	UINT32 batches;					/* forward wakeups that sent frames */
+} SV_STATS_S;
+
+/*
+ * Single producer single consumer ring between the receive hook and the
+ * forward task. The driver owns the hook buffer, so the hook copies the frame
+ * to slot[head] and the forward task sends it out of the slot in place.
+ */
+typedef struct sv_ring
+{
+	UINT32 head;					/* written by the polling task */
+	UINT32 tail;					/* written by the forward task */
+	UINT32 len[SV_RING_SIZE];
+	UINT8 * slot;					/* SV_RING_SIZE buffers of PKT_BUF_SIZE */
+} SV_RING;
+
 typedef struct sv_status
 {
 	int svFd;
@@ -7,27 +50,51 @@ typedef struct sv_status
 	int timerFd;
 	BOOL svInited;
 	SEM_ID muxSem;
+	SEM_ID fwdSem;
+	UINT8 srcMac[6];				/* debug port MAC, patched on forward */
+	SV_RING ring;
+	SV_STATS_S stats;
+	SV_RX_S rx;
+	STAT_SNAP * pSnap;
+	STAT_SNAP * pRxSnap;
 } SV_STATUS_S;
 
 static SV_STATUS_S * pStatus = NULL;
 
-#define PKT_BUF_SIZE	2048		/* SV packet buffer limit */
-#define SV_TIMER_FREQ	2400        /* SV sample rate 1200sps */
-
-#define SV_POLLING_TASK_PRIORITY	40
+/* svFwdBatch : frames sent per forward wakeup, 0 is taken as 1 */
+UINT32 svFwdBatch = SV_FWD_BATCH;
 
 static BOOL sv_recv_hook(void * pDev, UINT8 *buf, UINT32 bufLen)
 {
-    /* Update MAC */
-    eth_srcmac_fill(pStatus->ethFd, buf);
-    /* Send out */
-    assert(EthernetSendPkt(pStatus->ethFd, buf, bufLen) == 0);
+	SV_RING * pRing = &pStatus->ring;
+
+	pStatus->rx.recv++;
+	if (bufLen > PKT_BUF_SIZE)
+	{
+		pStatus->rx.tooLong++;
+		return TRUE;
+	}
+	if (pRing->head - pRing->tail >= SV_RING_SIZE)
+	{
+		pStatus->rx.ringDrop++;
+		return TRUE;
+	}
+
+	memcpy(pRing->slot + (pRing->head % SV_RING_SIZE) * PKT_BUF_SIZE, buf, bufLen);
+	pRing->len[pRing->head % SV_RING_SIZE] = bufLen;
+	/* Slot filled before it is handed over */
+	VX_MEM_BARRIER_W();
+	pRing->head++;
+	if (pRing->head - pRing->tail > pStatus->rx.ringHwm)
+		pStatus->rx.ringHwm = pRing->head - pRing->tail;
 
 	return TRUE;
 }
 
 static int polling_task(void)
 {
+	SV_RING * pRing = &pStatus->ring;
+
 	assert(pStatus->svInited == TRUE);
 	while(1)
 	{
@@ -36,9 +103,93 @@ static int polling_task(void)
 
 		/* Receive all packets pending */
 		while (EthernetRecvPoll(pStatus->svFd, NULL) == -EAGAIN);
+		stat_snap_publish(pStatus->pRxSnap, &pStatus->rx);
+
+		if (pRing->head != pRing->tail)
+			semGive(pStatus->fwdSem);
 	}
 }
 
+/*
+ * Send the ring in batches. A busy debug port keeps the frame in the ring
+ * and retries on the next wakeup, the hook drops once the ring is full.
+ */
+static int forward_task(void)
+{
+	SV_RING * pRing = &pStatus->ring;
+	UINT8 * pkt;
+	UINT32 sent, batch;
+	INT32 ret;
+
+	FOREVER
+	{
+		semTake(pStatus->fwdSem, (pRing->head != pRing->tail) ? 1 : STAT_SNAP_PERIOD);
+
+		batch = svFwdBatch ? svFwdBatch : 1;
+		for (sent = 0; (pRing->tail != pRing->head) && (sent < batch); sent++)
+		{
+			VX_MEM_BARRIER_R();
+			pkt = pRing->slot + (pRing->tail % SV_RING_SIZE) * PKT_BUF_SIZE;
+			/* Update MAC */
+			memcpy(pkt + 6, pStatus->srcMac, 6);
+			ret = EthernetSendPkt(pStatus->ethFd, pkt, pRing->len[pRing->tail % SV_RING_SIZE]);
+			if (ret == -EAGAIN)
+			{
+				pStatus->stats.sendBusy++;
+				break;
+			}
+			if (ret == 0)
+				pStatus->stats.forwarded++;
+			else
+				pStatus->stats.sendFail++;
+			/* Done with the slot before it is reused */
+			VX_MEM_BARRIER_RW();
+			pRing->tail++;
+		}
+		if (sent)
+			pStatus->stats.batches++;
+
+		/* Publish counters for sv_show() */
+		if (stat_snap_due(pStatus->pSnap))
+		{
+			stat_snap_read(pStatus->pRxSnap, &pStatus->stats.rx);
+			stat_snap_publish(pStatus->pSnap, &pStatus->stats);
+		}
+	}
+
+	return 0;
+}
+
+static void sv_stats_format(REPORT * pRep, const void * p)
+{
+	const SV_STATS_S * pStats = p;
+
+	report_printf(pRep, "\n"
+			"*********** SV ***********\n"
+			"Received               : %u\n"
+			"Forwarded              : %u\n"
+			"Batches                : %u\n"
+			"Ring High Water        : %u/%u\n"
+			"Ring Drop              : %u\n"
+			"Too Long               : %u\n"
+			"Send Busy              : %u\n"
+			"Send Fail              : %u\n",
+			pStats->rx.recv,
+			pStats->forwarded,
+			pStats->batches,
+			pStats->rx.ringHwm, SV_RING_SIZE,
+			pStats->rx.ringDrop,
+			pStats->rx.tooLong,
+			pStats->sendBusy,
+			pStats->sendFail);
+}
+
+/* All words, nothing to swap */
+const STATLOG_CODEC svStatlog =
+{
+	STATLOG_ID_SV, sizeof(SV_STATS_S), sv_stats_format, NULL
+};
+
 static void sv_init(void)
 {
 	/* Only init once */
@@ -67,6 +218,24 @@ static void sv_init(void)
 	/* Initialize semaphore */
 	pStatus->muxSem = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
 	assert(pStatus->muxSem != NULL);
+	pStatus->fwdSem = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
+	assert(pStatus->fwdSem != NULL);
+
+	/* Forward ring */
+	pStatus->ring.slot = malloc(SV_RING_SIZE * PKT_BUF_SIZE);
+	assert(pStatus->ring.slot);
+
+	/* The source MAC is the same for every frame forwarded */
+	eth_srcmac_fill(pStatus->ethFd, pStatus->ring.slot);
+	memcpy(pStatus->srcMac, pStatus->ring.slot + 6, 6);
+
+	pStatus->pSnap = stat_snap_create(sizeof(pStatus->stats), STAT_SNAP_PERIOD);
+	assert(pStatus->pSnap);
+	stat_snap_publish(pStatus->pSnap, &pStatus->stats);
+	pStatus->pRxSnap = stat_snap_create(sizeof(pStatus->rx), STAT_SNAP_PERIOD);
+	assert(pStatus->pRxSnap);
+	stat_snap_publish(pStatus->pRxSnap, &pStatus->rx);
+	statlog_register(STATLOG_ID_SV, pStatus->pSnap);
 
 	/* Configure ADC */
 	hsb_remote_reg_config(addr_get(), 0x7C00, 0x1 << addr_get());
@@ -88,8 +257,9 @@ static void sv_init(void)
 	/* Init done */
 	pStatus->svInited = TRUE;
 
-	/* Start polling task */
+	/* Start polling and forward task */
 	taskSpawn("tSVPoll", SV_POLLING_TASK_PRIORITY, 0, 0x40000, polling_task, 0,0,0,0,0,0,0,0,0,0);
+	taskSpawn("tSVFwd", SV_FWD_TASK_PRIORITY, 0, 0x4000, forward_task, 0,0,0,0,0,0,0,0,0,0);
 }
 
 static void sv_timer_hook(int arg)
@@ -109,9 +279,14 @@ static void sv_start(void)
 	assert(TimerEnable(pStatus->timerFd) == 0);
 }
 
-static void sv_show(char * buf)
+static void sv_show(REPORT * pRep)
 {
-    return;
+	SV_STATS_S stats;
+
+	if (!pStatus || !pStatus->svInited || stat_snap_read(pStatus->pSnap, &stats))
+		return;
+
+	sv_stats_format(pRep, &stats);
 }
 
 MODULE_REGISTER(sv);
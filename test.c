@@ -14,6 +14,8 @@ static SEM_ID displaySem;
 
 static int test_show_entry(int delay)
 {
+	REPORT rep;
+
 	/* Default to half an hour */
 	if (delay <= 0)
 		delay = 1800;
@@ -21,9 +23,11 @@ static int test_show_entry(int delay)
 	FOREVER
 	{
 		semTake(displaySem, delay * sysClkRateGet());
-		memset(print_buf, 0, PRINT_BUF_SIZE);
-		lib_show(print_buf);
-		logMsg(print_buf, 0,0,0,0,0,0);
+		report_init(&rep, print_buf, PRINT_BUF_SIZE);
+		lib_show(&rep);
+		/* Text to the console only, /tffs keeps the binary counters */
+		printf("%s", print_buf);
+		statlog_append(rep.len);
 		taskDelay(sysClkRateGet());
 	}
 